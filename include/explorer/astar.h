@@ -1,5 +1,6 @@
 #ifndef ASTAR_H
 #define ASTAR_H
+#include "explorer/local_map.h"
 #include <Eigen/Dense>
 #include <octomap/octomap.h>
 #include <ros/ros.h>
@@ -81,12 +82,12 @@ private:
   float min_z_ = 0.0;
 public:
   std::vector<AstarNode> path_;
-  float astar_path_distance(const octomap::OcTree *ocmap,
+  float astar_path_distance(const LocalMap &local_map,
                             const Eigen::Vector3f &start_p,
                             const Eigen::Vector3f &end_p);
   float calc_h_score(const Eigen::Vector3f &start_p,
                      const Eigen::Vector3f &end_p);
-  bool is_path_valid(const octomap::OcTree *ocmap,
+  bool is_path_valid(const LocalMap &local_map,
                      const Eigen::Vector3f &cur_pos,
                      const Eigen::Vector3f &next_pos);
 };
@@ -32,7 +32,6 @@ public:
   bool EmplaceRangeBack(const RangeVoxel &range);
   bool IsInBlock(const int y, const int z) const;
   std::vector<Block2D> GetOverlap(const Block2D &block) const;
-  float GetRoughDistance(const Block2D &block, const int delta_x) const;
   bool GetRangeAtY(const int y, RangeVoxel *range) const;
 };
 
@@ -88,4 +87,24 @@ public:
   }
 };
 
+// Lookup from voxel to the ID of the Block3D containing it. In each x slice,
+// the z ranges of the Block2D are grouped by y, so a query only checks the
+// ranges of a single column.
+class BlockIndex {
+private:
+  int num_y_ = 0;
+  std::vector<std::vector<int>> column_offsets_;
+  std::vector<std::vector<RangeVoxel>> column_ranges_;
+  std::vector<std::vector<int>> column_ids_;
+
+public:
+  BlockIndex() = default;
+  void Resize(const int num_x, const int num_y);
+  // Rebuild slice x from its Block2D and the ID of Block3D they belong to.
+  void UpdateSlice(const int x, const std::vector<Block2D> &blocks,
+                   const std::vector<int> &block_ids);
+  // Return -1 if the voxel is not in any block.
+  int GetBlockId(const int x, const int y, const int z) const;
+};
+
 #endif
@@ -2,6 +2,8 @@
 #define FRONTIER_CLUSTER_H
 
 #include "explorer/QuadMesh.h"
+#include "explorer/frontier_set.h"
+#include "explorer/local_map.h"
 #include <Eigen/Dense>
 #include <geometry_msgs/PoseArray.h>
 #include <octomap/octomap.h>
@@ -21,10 +23,10 @@ using namespace std;
 //// frontier clustering
 //// input = the set containing all frontier voxels
 //// output = a vector containing all frontier clusters
-vector<Cluster> k_mean_cluster(set<QuadMesh> &frontiers);
+vector<Cluster> k_mean_cluster(FrontierSet &frontiers);
 void cluster_visualize(vector<Cluster> &cluster_vec,
                        ros::Publisher &cluster_pub);
-vector<Cluster> dbscan_cluster(set<QuadMesh> &frontiers, const float &eps,
+vector<Cluster> dbscan_cluster(FrontierSet &frontiers, const float &eps,
                                const int &min_pts, const int &min_cluster_pts,
                                ros::Publisher &cluster_vis_pub);
 
@@ -32,5 +34,5 @@ vector<Cluster> dbscan_cluster(set<QuadMesh> &frontiers, const float &eps,
 //// input = a vector containing all frontier clusters
 //// output = a vector containing poses of all view points
 geometry_msgs::PoseArray view_point_generate(vector<Cluster> &cluster_vec,
-                                             octomap::OcTree *ocmap);
+                                             const LocalMap &local_map);
 #endif
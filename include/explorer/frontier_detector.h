@@ -1,6 +1,9 @@
 #ifndef FRONTIER_DETECTOR_H
 #define FRONTIER_DETECTOR_H
 #include "explorer/QuadMesh.h"
+#include "explorer/frontier_set.h"
+#include "explorer/local_map.h"
+#include <Eigen/Dense>
 #include <geometry_msgs/PointStamped.h>
 #include <octomap/octomap.h>
 #include <ros/ros.h>
@@ -10,16 +13,38 @@
 using namespace std;
 
 // detect frontier:
-// input = octomap; current pose; FOV; max range; region bbx
+// input = octomap; local map of the cycle; current pose; FOV; max range;
+// region bbx
 // output = a set containing all frontier voxels
-void frontier_detect(set<QuadMesh> &frontiers, octomap::OcTree *ocmap,
+void frontier_detect(FrontierSet &frontiers, octomap::OcTree *ocmap,
+                     const LocalMap &local_map,
                      const geometry_msgs::PointStamped &cur_pose,
                      const double &sensor_range);
-bool is_next_to_obstacle(octomap::OcTree *ocmap, const octomap::point3d &point,
+// Box of the local map of a cycle: the region of pose with margin, rounded out
+// to the cells of frontier_update, so that the changed keys of the map also
+// cover the leaves reaching out of the region.
+void cycle_map_bbx_get(const geometry_msgs::PointStamped &pose,
+                       const double &sensor_range, const double &margin,
+                       const double &resolution, Eigen::Vector3f *bbx_min,
+                       Eigen::Vector3f *bbx_max);
+// Incremental frontier_detect, for the next cycle from last_pose. Only the
+// frontiers and the leaves near changed_keys, or out of the region of the last
+// cycle, are checked again. changed_keys are the octomap keys of the voxels
+// changed since the last cycle, from the change detection of ocmap or
+// LocalMap::GetChangedKeys over the box of cycle_map_bbx_get. Changes outside
+// it are not seen.
+void frontier_update(FrontierSet &frontiers, octomap::OcTree *ocmap,
+                     const LocalMap &local_map,
+                     const geometry_msgs::PointStamped &cur_pose,
+                     const geometry_msgs::PointStamped &last_pose,
+                     const double &sensor_range,
+                     const vector<octomap::OcTreeKey> &changed_keys);
+bool is_next_to_obstacle(const LocalMap &local_map,
+                         const octomap::point3d &point,
                          const double &check_box_size, const double &occ_trs);
-void frontier_visualize(set<QuadMesh> &frontiers, const double &mesh_thickness,
+void frontier_visualize(FrontierSet &frontiers, const double &mesh_thickness,
                         ros::Publisher &frontier_maker_array_pub);
-void frontier_normal_visualize(set<QuadMesh> &frontiers,
+void frontier_normal_visualize(FrontierSet &frontiers,
                                ros::Publisher &frontier_normal_pub);
 
 #endif
@@ -0,0 +1,122 @@
+#ifndef FRONTIER_SET_H
+#define FRONTIER_SET_H
+#include "explorer/QuadMesh.h"
+#include <cstdint>
+#include <octomap/octomap.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Frontier faces keyed by (octree key, face direction, depth) in an open
+// addressing hash table, with the faces stored contiguously. The faces are
+// also indexed by buckets of kBucketSize voxels holding their centers, so that
+// an update only visits the buckets of its region.
+class FrontierSet {
+public:
+  using const_iterator = std::vector<QuadMesh>::const_iterator;
+
+  // resolution of the octomap the faces are found in
+  explicit FrontierSet(const double resolution = 0.1);
+  // false if the face is already in
+  bool Insert(const QuadMesh &mesh);
+  // false if the face is not in
+  bool Erase(const QuadMesh &mesh);
+  bool Contains(const QuadMesh &mesh) const;
+  void Clear();
+  // Erase the faces for which pred(mesh) holds.
+  template <typename Predicate> void EraseIf(Predicate &&pred);
+  // Same, only in the buckets for which is_bucket_in(bucket_min, bucket_max)
+  // holds, the bounds of the face centers in the bucket.
+  template <typename BucketPredicate, typename Predicate>
+  void EraseIf(BucketPredicate &&is_bucket_in, Predicate &&pred);
+  // Visit the faces of the buckets for which is_bucket_in holds.
+  template <typename BucketPredicate, typename Visitor>
+  void ForEach(BucketPredicate &&is_bucket_in, Visitor &&visit) const;
+  int size() const { return meshes_.size(); }
+  bool empty() const { return meshes_.empty(); }
+  // Largest face size since the last Clear, a face is within this distance
+  // of its leaf.
+  double max_size() const { return max_size_; }
+  // The order changes with the erased faces.
+  const_iterator begin() const { return meshes_.begin(); }
+  const_iterator end() const { return meshes_.end(); }
+
+private:
+  static constexpr int kBucketSize = 16;
+  static constexpr int kMinSlots = 64;
+  static constexpr int kEmpty = -1;
+
+  struct Bucket {
+    // bucket key, octomap key / kBucketSize
+    octomap::OcTreeKey key;
+    // indices in meshes_
+    std::vector<int> entries;
+  };
+
+  uint64_t KeyGet(const QuadMesh &mesh) const;
+  // Slot of key, or the empty slot where it would go.
+  int SlotFind(const uint64_t key) const;
+  // Empty the slot and shift back the slots after it.
+  void SlotErase(int slot);
+  void Rehash(const int num_slots);
+  void EraseAt(const int index);
+  octomap::point3d BucketMin(const int bucket) const;
+  octomap::point3d BucketMax(const int bucket) const;
+
+  double resolution_ = 0.1;
+  // Same factor as the octomap keys.
+  double resolution_factor_ = 10.0;
+  double max_size_ = 0.0;
+  std::vector<QuadMesh> meshes_;
+  std::vector<uint64_t> keys_;
+  // (bucket, index in Bucket::entries) of each face
+  std::vector<std::pair<int, int>> bucket_refs_;
+  // index in meshes_ or kEmpty, linear probing in a power of two slots
+  std::vector<int> slots_;
+  std::vector<Bucket> buckets_;
+  std::unordered_map<uint64_t, int> bucket_at_;
+};
+
+template <typename Predicate> void FrontierSet::EraseIf(Predicate &&pred) {
+  // The last face is moved in place of an erased one, it is already checked.
+  for (int i = static_cast<int>(meshes_.size()) - 1; i >= 0; --i) {
+    if (pred(meshes_[i])) {
+      EraseAt(i);
+    }
+  }
+}
+
+template <typename BucketPredicate, typename Predicate>
+void FrontierSet::EraseIf(BucketPredicate &&is_bucket_in, Predicate &&pred) {
+  for (int b = 0; b < buckets_.size(); ++b) {
+    if (buckets_[b].entries.empty() ||
+        !is_bucket_in(BucketMin(b), BucketMax(b))) {
+      continue;
+    }
+    // The last entry of the bucket is moved in place of an erased one.
+    const std::vector<int> &entries = buckets_[b].entries;
+    for (int i = 0; i < entries.size();) {
+      if (pred(meshes_[entries[i]])) {
+        EraseAt(entries[i]);
+      } else {
+        ++i;
+      }
+    }
+  }
+}
+
+template <typename BucketPredicate, typename Visitor>
+void FrontierSet::ForEach(BucketPredicate &&is_bucket_in,
+                          Visitor &&visit) const {
+  for (int b = 0; b < buckets_.size(); ++b) {
+    if (buckets_[b].entries.empty() ||
+        !is_bucket_in(BucketMin(b), BucketMax(b))) {
+      continue;
+    }
+    for (const int index : buckets_[b].entries) {
+      visit(meshes_[index]);
+    }
+  }
+}
+
+#endif
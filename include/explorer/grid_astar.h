@@ -2,8 +2,10 @@
 #define GRID_ASTAR_H
 #include "explorer/block.h"
 #include <Eigen/Dense>
+#include <jps_planner/jps_planner/jps_planner.h>
 #include <octomap/octomap.h>
 #include <ros/ros.h>
+#include <unordered_map>
 #include <vector>
 
 class GridAstarNode {
@@ -84,6 +86,25 @@ public:
   KeyBlock(const KeyBlock &rhs) = default;
   KeyBlock(const int x, const int block_id, const Block2D &block)
       : x_(x), block_id_(block_id), block_(block){};
+  // Distance from the center of the key block to the voxel.
+  float GetDistance(const int x, const int y, const int z) const;
+};
+
+// Connection between the Block2D of two adjacent x slices that belong to
+// different Block3D.
+class BlockConnection {
+public:
+  // Index of the Block2D in the last slice.
+  int last_index_ = 0;
+  // Index of the Block2D in the current slice.
+  int index_ = 0;
+  Block2D overlap_;
+
+public:
+  BlockConnection() = default;
+  BlockConnection(const int last_index, const int index,
+                  const Block2D &overlap)
+      : last_index_(last_index), index_(index), overlap_(overlap){};
 };
 
 class GraphEdge {
@@ -98,19 +119,80 @@ public:
 class GraphNode {
 public:
   KeyBlock key_block_;
-  std::vector<GraphEdge> edges_;
+  // Key blocks in the same Block3D are nodes_[block_begin_, block_end_).
+  int block_begin_ = 0;
+  int block_end_ = 0;
   GraphNode() = default;
   GraphNode(const KeyBlock &key_block) : key_block_(key_block){};
 };
 
+// Graph of unique key blocks. Key blocks of adjacent Block3D are connected by
+// the edges in CSR form. Key blocks in the same Block3D are stored together
+// and implicitly connected by the distance between their centers, which keeps
+// the shortest paths of the complete intra-block graph without storing it.
 class GraphTable {
 public:
   std::vector<GraphNode> nodes_;
+  // Edges of node i are edges_[edge_offsets_[i], edge_offsets_[i + 1]).
+  std::vector<int> edge_offsets_;
+  std::vector<GraphEdge> edges_;
+  // Centers of the key blocks in grid units.
+  std::vector<Eigen::Vector3f> centers_;
+
+private:
+  class PendingEdge {
+  public:
+    KeyBlock src_;
+    KeyBlock dest_;
+    float weight_ = 0.0;
+    PendingEdge(const KeyBlock &src, const KeyBlock &dest, const float weight)
+        : src_(src), dest_(dest), weight_(weight){};
+  };
+  std::vector<PendingEdge> pending_edges_;
+  // Edge between two nodes, kept to patch the CSR.
+  class Link {
+  public:
+    int src_ = 0;
+    int dest_ = 0;
+    float weight_ = 0.0;
+    Link(const int src, const int dest, const float weight)
+        : src_(src), dest_(dest), weight_(weight){};
+  };
+  std::vector<Link> links_;
+  // First node of each Block3D.
+  std::unordered_map<int, int> block_begin_;
+  // Centers, node ranges of the blocks and CSR edges from nodes_ and links_.
+  void IndexBuild();
+
+public:
+  // Edges are buffered until Build is called.
   void AddNewEdge(const KeyBlock &src_key_block, const KeyBlock &dest_key_block,
                   const float weight = 1.0);
-  void AddEdgeBetweenExistingNode(const int src_id, const int dest_id,
-                                  const float weight);
-  void UpdateEdgesInSameBlock();
+  // Deduplicate key blocks and build the adjacency.
+  void Build();
+  // Replace the edges whose dest key block is in slices [x_min, x_max] by the
+  // buffered edges. Only the new key blocks are deduplicated, and the nodes of
+  // the blocks that change are moved to the end, so the node ids change.
+  void Patch(const int x_min, const int x_max);
+  // Return false if no key block belongs to the block.
+  bool GetBlockNodes(const int block_id, int *begin, int *end) const;
+  template <typename Visitor>
+  void ForEachEdge(const int node_index, Visitor &&visit) const {
+    for (int e = edge_offsets_[node_index]; e < edge_offsets_[node_index + 1];
+         ++e) {
+      visit(edges_[e].dest_id_, edges_[e].weight_);
+    }
+    // Key blocks of the same block are linked by the exact distance between
+    // their centers, so that the Euclidean distance stays a consistent
+    // heuristic on the block graph.
+    const GraphNode &node = nodes_[node_index];
+    const Eigen::Vector3f &center = centers_[node_index];
+    for (int i = node.block_begin_; i < node.block_end_; ++i) {
+      if (i != node_index) {
+        visit(i, (center - centers_[i]).norm());
+      }
+    }
+  }
 };
 
 struct GridAstarOutput {
@@ -132,17 +214,65 @@ private:
   float max_z_ = 2.5;
   float resolution_ = 0.1;
   std::vector<std::vector<std::vector<GridState>>> grid_map_;
+  // grid_map_ in the layout of JPS::MapUtil, x changes fastest. Unknown cells
+  // are occupied, as only free cells are expanded.
+  std::vector<signed char> jps_map_;
+  void InitJpsMap();
+  // Jump distances of JPS on jps_map_, null unless EnableJumpTable is called.
+  std::shared_ptr<JPS::JumpTable> jump_table_;
+  // Box of the cells changed since the jump table was updated. Empty if
+  // jump_dirty_min_[0] > jump_dirty_max_[0].
+  int jump_dirty_min_[3] = {0, 0, 0};
+  int jump_dirty_max_[3] = {-1, -1, -1};
+  void MarkJumpTableDirty(const int *box_min, const int *box_max);
+  void UpdateJumpTable();
   std::vector<std::vector<std::vector<RangeVoxel>>> merge_map_;
   std::vector<std::vector<Block2D>> merge_map_2d_;
   std::vector<Block3D> merge_map_3d_;
   std::vector<std::shared_ptr<GridAstarNode>> path_;
   std::vector<int> block_path_;
   std::vector<std::vector<float>> ilqr_path_;
+  // Range of x slices whose occupancy changed since the last MergeMap3D. Empty
+  // if dirty_x_min_ > dirty_x_max_.
+  int dirty_x_min_ = 0;
+  int dirty_x_max_ = -1;
+  void MarkDirtyX(const int x_min, const int x_max);
+  void ClearDirtyX();
+  // Rasterize an octree leaf into grid_map_, only writing slices in
+  // [slab_x_min, slab_x_max]. The box of the changed grids, x, y, z in
+  // changed_min and changed_max, is extended. Return false if no grid changes
+  // its state.
+  bool RasterizeLeaf(const octomap::point3d &center, const float size,
+                     const float occ_probility, const int slab_x_min,
+                     const int slab_x_max, int *changed_min, int *changed_max);
   // Return the set of merged_voxels.
-  std::vector<Block2D>
-  Merge2DVoxelAlongY(const std::vector<std::vector<RangeVoxel>> &yz_voxels);
+  std::vector<Block2D> Merge2DVoxelAlongY(
+      const std::vector<std::vector<RangeVoxel>> &yz_voxels) const;
   std::vector<Block3D>
   Merge3DVoxelAlongX(const std::vector<std::vector<Block2D>> &xyz_voxels);
+  // Decide which Block2D of the last slice is continued by each Block2D of the
+  // slice (-1 for a new Block3D), and the connections between the others.
+  void LinkBlock2D(const std::vector<Block2D> &last_yz_voxels,
+                   const std::vector<Block2D> &yz_voxels,
+                   std::vector<int> *links,
+                   std::vector<BlockConnection> *connections) const;
+  // Re-link the slices in [x_min, x_max] and patch the Block3D crossing them.
+  // IDs of Block3D in the untouched region are kept.
+  void UpdateBlock3D(const std::vector<std::vector<Block2D>> &xyz_voxels,
+                     const int x_min, const int x_max);
+  // Label all Block2D from block_2d_links_. The slices are split into chunks
+  // labeled in parallel, and the partial Block3D are stitched at the borders.
+  void LabelBlock2D();
+  // Rebuild the edges of the connections of slices [x_min, x_max], the whole
+  // table if they cover all slices.
+  void UpdateGraphTable(const int x_min, const int x_max);
+  // Decomposition state per x slice, indexed in the same order as the Block2D
+  // of the slice.
+  std::vector<std::vector<int>> block_2d_links_;
+  std::vector<std::vector<int>> block_2d_ids_;
+  std::vector<std::vector<BlockConnection>> block_connections_;
+  int next_block_id_ = 0;
+  BlockIndex block_index_;
   GraphTable graph_table_;
 
 public:
@@ -154,6 +284,7 @@ public:
   const std::vector<int> &block_path() const;
   const std::vector<std::vector<float>> &ilqr_path() const;
   const GraphTable &graph_table() const;
+  bool GetDirtyXRange(int *x_min, int *x_max) const;
 
   GridAstar(const float min_x, const float max_x, const float min_y,
             const float max_y, const float min_z, const float max_z,
@@ -165,6 +296,18 @@ public:
   void UpdateFromMap(const octomap::OcTree *ocmap,
                      const octomap::point3d &bbx_min,
                      const octomap::point3d &bbx_max);
+  // Only rasterize the leaves reported by the change detection of octomap.
+  // UpdateFromMap should be called once before enabling this mode.
+  void UpdateFromChangedKeys(octomap::OcTree *ocmap,
+                             const octomap::point3d &bbx_min,
+                             const octomap::point3d &bbx_max);
+  // Only rasterize the voxels of keys, the voxels changed since the grid was
+  // last updated from the same map. With a new octomap received each cycle,
+  // the keys come from LocalMap::GetChangedKeys.
+  void UpdateFromKeys(const octomap::OcTree *ocmap,
+                      const std::vector<octomap::OcTreeKey> &keys,
+                      const octomap::point3d &bbx_min,
+                      const octomap::point3d &bbx_max);
   void MergeMap();
   void Merge2DVoxelAlongYUnitTest();
   void MergeMap2D();
@@ -172,8 +315,28 @@ public:
   void MergeMap3D();
   GridAstarOutput AstarPathDistance(const Eigen::Vector3f &start_p,
                                     const Eigen::Vector3f &end_p);
+  // Jump point search on a view of grid_map_.
+  GridAstarOutput JpsPathDistance(const Eigen::Vector3f &start_p,
+                                  const Eigen::Vector3f &end_p);
+  // Precompute the straight jumps of JpsPathDistance (JPS+). After map updates
+  // the table is only recomputed around the changed cells, before the next
+  // search.
+  void EnableJumpTable();
+  void DisableJumpTable();
+  // A* on the graph of key blocks. Without heuristic it is a plain Dijkstra.
   float BlockPathDistance(const Eigen::Vector3f &start_p,
-                          const Eigen::Vector3f &end_p);
+                          const Eigen::Vector3f &end_p,
+                          const bool use_heuristic = true);
+  float BidirectionalBlockPathDistance(const Eigen::Vector3f &start_p,
+                                       const Eigen::Vector3f &end_p);
+  // Distances from start_p to each of end_ps on the block graph, same as
+  // BlockPathDistance. Thread-safe, block_path_ is not modified.
+  std::vector<float>
+  BlockPathDistances(const Eigen::Vector3f &start_p,
+                     const std::vector<Eigen::Vector3f> &end_ps) const;
+  // Cost matrix between all pairs of points, rows are computed in parallel.
+  std::vector<std::vector<float>>
+  BlockPathDistanceMatrix(const std::vector<Eigen::Vector3f> &points) const;
   float BlockPathRefine(const std::vector<int> &block_path,
                         const Eigen::Vector3f &start_p,
                         const Eigen::Vector3f &end_p);
@@ -1,12 +1,16 @@
 #ifndef HASTAR_H
 #define HASTAR_H
+#include "explorer/local_map.h"
 #include <Eigen/Dense>
+#include <chrono>
 #include <octomap/octomap.h>
 #include <ros/ros.h>
 
 using namespace std;
 const float kDiv = 12.0 / 2.0;
 const float PI = 3.14159;
+// yaw bins of the search, -kDiv to kDiv
+const int YAW_BINS = 2 * kDiv + 1;
 
 class PathNode {
 private:
@@ -17,6 +21,8 @@ public:
 
   // father_yaw + father_yaw_offset = yaw
   float father_yaw_offset;
+  // primitive from the father, index in the primitive table
+  int primitive_id = -1;
   int father_id;
   float f_score, g_score, h_score;
 
@@ -108,8 +114,85 @@ public:
   float yaw_rate;
 };
 
+// Motion primitive of a constant yaw rate over duration, in the frame of its
+// start heading: x along the heading, y to the left.
+class Primitive {
+public:
+  float omega;
+  float duration;
+  // yaw change over duration
+  float yaw_offset;
+  Eigen::Vector2f end_offset;
+  // trajectory samples every traj_sample from the start
+  vector<float> sample_yaw_offset;
+  vector<Eigen::Vector2f> sample_pos;
+  vector<Eigen::Vector2f> sample_vel;
+  vector<Eigen::Vector2f> sample_acc;
+};
+
 class Hastar {
 private:
+  // The yaw is continuous, so the table is indexed by omega only and rotated
+  // by the heading of each node.
+  vector<Primitive> primitives_;
+  float primitives_tau_ = 0.0;
+  float primitives_sample_ = 0.0;
+  // rebuild the table when tau or traj_sample changed
+  void primitives_generate();
+  Primitive primitive_make(const float &omega, const float &duration) const;
+  // ids past the table are the segments of shot_
+  const Primitive &primitive_get(const int &id) const;
+
+  // Analytic expansion: the tightest turn towards the goal then a straight
+  // line, a Dubins curve to a point at MAX_VEL.
+  vector<Primitive> shot_;
+  // node the shot starts from, -1 without shot
+  int shot_id_ = -1;
+  float shot_time_ = 0.0;
+  bool shot_try(const LocalMap &local_map, const int &node_id);
+
+  // Dense (x, y, z, yaw bin) state space over a window around start and goal,
+  // a cell is unvisited unless its epoch is the one of the search.
+  struct Cell {
+    uint32_t epoch = 0;
+    bool closed = false;
+    float g_score = 0.0;
+  };
+  vector<Cell> cells_;
+  uint32_t epoch_ = 0;
+  Eigen::Vector3i window_min_ = Eigen::Vector3i::Zero();
+  Eigen::Vector3i window_size_ = Eigen::Vector3i::Zero();
+  // every pushed node, father_id indexes it
+  vector<PathNode> node_pool_;
+  // cell of each pooled node
+  vector<int> node_cell_;
+  void window_reset(const Eigen::Vector3f &start_p,
+                    const Eigen::Vector3f &end_p);
+  // index in cells_, -1 outside the window
+  int state_index(const Eigen::Vector3f &position, const float &yaw) const;
+
+  // Weighted A* with f = g + epsilon_ * h. With a time budget it restarts
+  // with a smaller epsilon_ after each path, keeping the cheapest one.
+  // heap of (f_score, index in node_pool_)
+  vector<pair<float, int>> open_;
+  vector<PathNode> roots_;
+  Eigen::Vector3f goal_ = Eigen::Vector3f::Zero();
+  float epsilon_ = 1.0;
+  float best_cost_ = 0.0;
+  // expanded node closest to the goal
+  int partial_id_ = -1;
+  // the last search emptied the open list without a path
+  bool is_exhausted_ = false;
+  // new epoch with the roots in the open list
+  void search_restart(const LocalMap &local_map);
+  bool root_add(const LocalMap &local_map, const PathNode &root);
+  bool search_loop(const LocalMap &local_map);
+  // pool index of the first node at the goal, -1 when the open list is empty
+  // or the budget is out
+  int expand(const LocalMap &local_map,
+             const chrono::steady_clock::time_point &start_time,
+             bool &is_timeout);
+  void path_generate(const int &goal_id, const bool &is_complete);
   bool trajectory_generate(const float &yaw);
 
 public:
@@ -117,12 +200,26 @@ public:
   float traj_sample = 0.05;
   vector<Traj> traj;
   vector<PathNode> path;
-  bool search_path(const octomap::OcTree *ocmap, const Eigen::Vector3f &start_p,
+  // closed nodes of the last search
+  int num_expansions = 0;
+  // wall-clock budget of a search in ms, 0 for none
+  float time_budget = 0.0;
+  // the path ends at the node closest to the goal, the budget ran out
+  bool is_partial = false;
+  // try an analytic expansion to the goal every few expansions
+  bool analytic_shot = true;
+  // Primitives inside the distance field of local_map are checked with a few
+  // clearance lookups, the others voxel by voxel.
+  bool search_path(const LocalMap &local_map, const Eigen::Vector3f &start_p,
                    const Eigen::Vector3f &end_p, const float &yaw);
-  float calc_h_score(const octomap::OcTree *ocmap,
+  // Search again to the last goal from a shifted start, in the same
+  // local_map. When the last search ran out of nodes, its tree is reused.
+  bool resume_path(const LocalMap &local_map, const Eigen::Vector3f &start_p,
+                   const float &yaw);
+  float calc_h_score(const LocalMap &local_map,
                      const Eigen::Vector3f &start_p,
                      const Eigen::Vector3f &end_p);
-  bool is_path_valid(const octomap::OcTree *ocmap,
+  bool is_path_valid(const LocalMap &local_map,
                      const Eigen::Vector3f &cur_pos,
                      const Eigen::Vector3f &next_pos);
 };
@@ -0,0 +1,96 @@
+#ifndef LEAF_GRAPH_H
+#define LEAF_GRAPH_H
+#include <Eigen/Dense>
+#include <cstdint>
+#include <octomap/octomap.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Face adjacency of the free leaves of an octomap, in CSR form. The space is
+// split into aligned blocks of kBlockSize voxels and leaves larger than a
+// block are split at its borders, so that the blocks of changed keys can be
+// rebuilt alone.
+class LeafGraph {
+public:
+  // Cube of free voxels [key, key + size) in octomap keys.
+  struct Leaf {
+    Eigen::Vector3i key;
+    int size;
+    Eigen::Vector3f center;
+  };
+
+  // Collect the free leaves and their face neighbors, block by block in
+  // parallel. ocmap must outlive the next Build or Update.
+  void Build(const octomap::OcTree *ocmap);
+  // Rebuild the blocks of keys, the voxels changed since the last Build or
+  // Update, and the edges of the blocks next to them. ocmap may be a new
+  // octree of the same map, as LocalMap::GetChangedKeys finds the keys
+  // between two of them. The leaf ids change.
+  void Update(const octomap::OcTree *ocmap,
+              const std::vector<octomap::OcTreeKey> &keys);
+  // Free leaf containing p, -1 if p is not in a free leaf.
+  int Find(const Eigen::Vector3f &p) const;
+  int size() const { return leaves_.size(); }
+  int num_edges() const { return neighbors_.size(); }
+  const Leaf &leaf(const int id) const { return leaves_[id]; }
+  template <typename Visitor>
+  void ForEachNeighbor(const int id, Visitor &&visit) const {
+    for (int e = offsets_[id]; e < offsets_[id + 1]; ++e) {
+      visit(neighbors_[e]);
+    }
+  }
+
+private:
+  static constexpr int kTreeMaxVal = 32768;
+  static constexpr int kTreeSize = 65536;
+  static constexpr int kBlockLevel = 4;
+  static constexpr int kBlockSize = 1 << kBlockLevel;
+
+  // Leaf of a block, index in Block::leaves.
+  struct LeafRef {
+    int block;
+    int index;
+  };
+  struct Block {
+    // first voxel
+    Eigen::Vector3i key;
+    std::vector<Leaf> leaves;
+    // index in leaves of each voxel, -1 if not free, voxel (i, j, k) of the
+    // block is at i + kBlockSize * (j + kBlockSize * k)
+    std::vector<int16_t> voxel_leaves;
+    // (index in leaves, neighbor) found by the face probes of the leaves. A
+    // leaf keeps the neighbors that are larger, or of the same size in the
+    // positive direction, the others find it.
+    std::vector<std::pair<int, LeafRef>> edges;
+  };
+
+  static uint64_t BlockHash(const Eigen::Vector3i &key);
+  // Keys of the blocks with known voxels under node.
+  void BlockKeysCollect(const octomap::OcTreeNode *node,
+                        const Eigen::Vector3i &key, const int size,
+                        std::vector<Eigen::Vector3i> *block_keys) const;
+  void BlockBuild(Block *block) const;
+  void LeavesCollect(const octomap::OcTreeNode *node,
+                     const Eigen::Vector3i &key, const int size,
+                     Block *block) const;
+  void BlockLink(Block *block) const;
+  // Leaf holding the voxel key, block -1 if none.
+  LeafRef FindKey(const Eigen::Vector3i &key) const;
+  void CsrBuild();
+
+  const octomap::OcTree *ocmap_ = nullptr;
+  float resolution_ = 0.1;
+  // Same factor as the octomap keys.
+  double resolution_factor_ = 10.0;
+  std::vector<Block> blocks_;
+  std::unordered_map<uint64_t, int> block_at_;
+  // The blocks flattened, the leaves of block b start at block_offsets_[b].
+  std::vector<int> block_offsets_;
+  std::vector<Leaf> leaves_;
+  // Neighbors of leaf i are neighbors_[offsets_[i], offsets_[i + 1]).
+  std::vector<int> offsets_;
+  std::vector<int> neighbors_;
+};
+
+#endif
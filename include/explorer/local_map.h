@@ -0,0 +1,105 @@
+#ifndef LOCAL_MAP_H
+#define LOCAL_MAP_H
+#include <Eigen/Dense>
+#include <cstdint>
+#include <octomap/octomap.h>
+#include <vector>
+
+// Dense copy of the octomap in a local box around the planners, aligned with
+// the octomap voxels. Besides the state of each voxel, it keeps the Euclidean
+// distance to the nearest occupied voxel of the box. Lookups outside the box
+// fall back to a larger map or to the octomap, so one map can be shared by a
+// whole cycle.
+class LocalMap {
+public:
+  enum class VoxelState : uint8_t { kUnknown = 0, kFree, kOcc };
+
+  // Rasterize the leaves of ocmap in [bbx_min, bbx_max], shrunk to the known
+  // leaves, and compute the distance field if asked.
+  // Occupied voxels outside the box are not seen, so the distances are only
+  // exact up to the distance to the border. ocmap must outlive the next
+  // Update.
+  void Update(const octomap::OcTree *ocmap, const Eigen::Vector3f &bbx_min,
+              const Eigen::Vector3f &bbx_max,
+              const bool compute_distance = true);
+  // Lookups outside the box go to fallback instead of the octomap, fallback
+  // must cover the same octomap.
+  void set_fallback(const LocalMap *fallback) { fallback_ = fallback; }
+  // Whether p is in the box and at least margin away from its border.
+  bool IsInside(const Eigen::Vector3f &p, const float margin = 0.0) const;
+  // Same voxel as ocmap->search(p), searched in the fallback or the octomap
+  // outside the box.
+  VoxelState GetState(const Eigen::Vector3f &p) const;
+  // Occupancy probability of the voxel of p, negative if unknown.
+  float GetOccupancy(const Eigen::Vector3f &p) const;
+  // Distance from the voxel of p to the nearest occupied voxel, 0 outside the
+  // box or without distance field.
+  float GetDistance(const Eigen::Vector3f &p) const;
+  // Octomap keys of the voxels of the box whose state or occupancy differ in
+  // last, or that are outside the box of last. With a new octomap received
+  // each cycle, this stands for its change detection.
+  void GetChangedKeys(const LocalMap &last,
+                      std::vector<octomap::OcTreeKey> *keys) const;
+  // Summed-area tables of the voxels with an occupancy above occ_trs, one per
+  // xy slice of the box. Cleared by Update.
+  void ComputeOccupancySums(const double occ_trs);
+  // Number of voxels with an occupancy above occ_trs in the xy rectangle from
+  // the voxel of p_min to the voxel of p_max, in the slice of p_min. -1 if the
+  // sums of occ_trs are not computed or the rectangle leaves the box.
+  int CountOccupancyAbove(const Eigen::Vector3f &p_min,
+                          const Eigen::Vector3f &p_max,
+                          const double occ_trs) const;
+  bool has_distance() const { return !distances_.empty(); }
+  float resolution() const { return resolution_; }
+  // Box after Update, on the voxel borders.
+  const Eigen::Vector3f &bbx_min() const { return bbx_min_; }
+  const Eigen::Vector3f &bbx_max() const { return bbx_max_; }
+
+private:
+  // Voxel keys covered by an octomap leaf, [key_begin, key_end).
+  struct Leaf {
+    Eigen::Vector3i key_begin;
+    Eigen::Vector3i key_end;
+    VoxelState state;
+    float occupancy;
+  };
+
+  // Summed-area tables of a threshold. The sum of the voxels [0, i) x [0, j)
+  // of slice k is at i + (size_.x() + 1) * (j + (size_.y() + 1) * k). Counts
+  // are modulo 2^16, exact for the rectangles of fewer voxels.
+  struct OccupancySums {
+    double occ_trs;
+    std::vector<uint16_t> sums;
+  };
+
+  // Index of the voxel of p, -1 outside the box.
+  int GetIndex(const Eigen::Vector3f &p) const;
+  // Squared distance transform along a line of n voxels with the given stride,
+  // lower envelope of parabolas (Felzenszwalb and Huttenlocher).
+  void DistanceTransform1D(float *f, const int n, const int stride);
+
+  const octomap::OcTree *ocmap_ = nullptr;
+  const LocalMap *fallback_ = nullptr;
+  float resolution_ = 0.1;
+  // Same factor as the octomap keys, so that points on a voxel border fall in
+  // the same voxel.
+  double resolution_factor_ = 10.0;
+  // Voxel key of the first voxel, floor(coordinate / resolution).
+  Eigen::Vector3i origin_key_ = Eigen::Vector3i::Zero();
+  Eigen::Vector3i size_ = Eigen::Vector3i::Zero();
+  Eigen::Vector3f bbx_min_ = Eigen::Vector3f::Zero();
+  Eigen::Vector3f bbx_max_ = Eigen::Vector3f::Zero();
+  // Voxel (i, j, k) is at i + size_.x() * (j + size_.y() * k).
+  std::vector<VoxelState> states_;
+  std::vector<float> occupancies_;
+  std::vector<float> distances_;
+  std::vector<OccupancySums> occupancy_sums_;
+  // Buffer of Update.
+  std::vector<Leaf> leaves_;
+  // Buffers of DistanceTransform1D.
+  std::vector<float> line_f_;
+  std::vector<float> line_z_;
+  std::vector<int> line_v_;
+};
+
+#endif
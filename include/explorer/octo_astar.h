@@ -1,14 +1,13 @@
 #ifndef OCTO_ASTAR_H
 #define OCTO_ASTAR_H
+#include "explorer/leaf_graph.h"
 #include <Eigen/Dense>
-#include <memory>
+#include <cstdint>
 #include <octomap/octomap.h>
-#include <queue>
 #include <ros/ros.h>
-#include <unordered_map>
 #include <vector>
 
-// wrapper of octomap node
+// wrapper of octomap node, linked by index in the arena of OctoAstar
 class OctoNode {
 public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -18,20 +17,24 @@ public:
   Eigen::Vector3f bbx_max_;
   float size_ = 0.0;
   float half_size_ = 0.0;
-  std::shared_ptr<OctoNode> father_node_ = nullptr;
-  std::vector<std::shared_ptr<OctoNode>> child_node_;
+  // -1 for the root
+  int father_id_ = -1;
+  // -1 until the child is wrapped
+  int child_id_[8] = {-1, -1, -1, -1, -1, -1, -1, -1};
+  // A* node of the leaf, valid in search search_id_ only
+  uint32_t search_id_ = 0;
+  int astar_id_ = -1;
 
   OctoNode(octomap::OcTreeNode *node, const Eigen::Vector3f &center, float size,
-           std::shared_ptr<OctoNode> father_node)
+           int father_id)
       : node_(node), center_(center), size_(size), half_size_(0.5 * size),
-        father_node_(father_node) {
+        father_id_(father_id) {
     Eigen::Vector3f offset(half_size_, half_size_, half_size_);
     bbx_min_ = center_ - offset;
     bbx_max_ = center_ + offset;
-    child_node_.resize(8, nullptr);
   }
 
-  bool is_in_bbx(const Eigen::Vector3f &p) {
+  bool is_in_bbx(const Eigen::Vector3f &p) const {
     bool is_x_in_bbx = (bbx_min_.x() <= p.x()) && (p.x() <= bbx_max_.x());
     bool is_y_in_bbx = (bbx_min_.y() <= p.y()) && (p.y() <= bbx_max_.y());
     bool is_z_in_bbx = (bbx_min_.z() <= p.z()) && (p.z() <= bbx_max_.z());
@@ -39,53 +42,12 @@ public:
   }
 };
 
-class OctoAstarNodeKey {
-public:
-  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-  Eigen::Vector3f position_;
-
-  OctoAstarNodeKey(const Eigen::Vector3f &position) : position_(position) {}
-  // 用于unordered_map
-  bool operator==(const OctoAstarNodeKey &n) const {
-    int x0 = static_cast<int>(round(position_.x() / 0.1));
-    int y0 = static_cast<int>(round(position_.y() / 0.1));
-    int z0 = static_cast<int>(round(position_.z() / 0.1));
-
-    int x1 = static_cast<int>(round(n.position_.x() / 0.1));
-    int y1 = static_cast<int>(round(n.position_.y() / 0.1));
-    int z1 = static_cast<int>(round(n.position_.z() / 0.1));
-
-    return x0 == x1 && y0 == y1 && z0 == z1;
-  }
-};
-
-// 用于unordered_map
-struct OctoAstarNodeHash {
-  size_t operator()(const OctoAstarNodeKey &key) const {
-    // x max_range: [-50, 50], 10 bit
-    // y max_range: [-50, 50], 10 bit
-    // z max_range: [0, 3], 5 bit
-    // key = x  y   z
-    // bit = 24-15   14-5    4-0
-    int x0 = static_cast<int>(round(key.position_.x() / 0.1)) & 0x3FF;
-    x0 <<= 15;
-    int y0 = static_cast<int>(round(key.position_.y() / 0.1)) & 0x3FF;
-    y0 <<= 5;
-    int z0 = static_cast<int>(round(key.position_.z() / 0.1)) & 0x1F;
-    z0 <<= 0;
-
-    int hash_value = x0 | y0 | z0;
-    // return static_cast<size_t>(key);
-    return std::hash<int>()(hash_value);
-  }
-};
-
 class OctoAstarNode {
 public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
   Eigen::Vector3f position_;
-  std::shared_ptr<OctoNode> octo_node_ = nullptr;
-  std::shared_ptr<OctoAstarNode> father_node_ = nullptr;
+  int octo_id_ = -1;
+  int father_id_ = -1;
   float f_score_ = 0.0;
   float g_score_ = 0.0;
   float h_score_ = 0.0;
@@ -95,11 +57,11 @@ public:
   OctoAstarNode(const Eigen::Vector3f &position) : position_(position) {}
 };
 
-// 用于优先队列
+// 用于优先队列, (f_score, index in the A* nodes)
 struct OctoAstarNodeCmp {
-  bool operator()(const std::shared_ptr<OctoAstarNode> &lhs,
-                  const std::shared_ptr<OctoAstarNode> &rhs) {
-    return lhs->f_score_ > rhs->f_score_;
+  bool operator()(const std::pair<float, int> &lhs,
+                  const std::pair<float, int> &rhs) {
+    return lhs.first > rhs.first;
   }
 };
 
@@ -108,31 +70,51 @@ private:
   float max_z_ = 2.0;
   float min_z_ = 1.0;
   const octomap::OcTree *ocmap_ = nullptr;
-  std::shared_ptr<OctoNode> root_node_ = nullptr;
-  std::unordered_map<OctoAstarNodeKey, std::shared_ptr<OctoAstarNode>,
-                     OctoAstarNodeHash>
-      node_at_key;
+  // Wrappers of the octree nodes, the root first. They are kept for the
+  // planner's lifetime since the octree does not change under it.
+  std::vector<OctoNode> octo_nodes_;
+  // A* nodes of the current search, dropped at the next one
+  std::vector<OctoAstarNode> astar_nodes_;
+  uint32_t search_id_ = 0;
+  // heap of the open nodes and bfs queue, kept for their capacity
+  std::vector<std::pair<float, int>> astar_q_;
+  std::vector<int> bfs_q_;
+  // A* state of the leaves of a LeafGraph, valid in search search_id_ only
+  struct LeafState {
+    uint32_t search_id = 0;
+    bool is_closed = false;
+    int father_id = -1;
+    float g_score = 0.0;
+  };
+  std::vector<LeafState> leaf_states_;
+  // wrapper of a child, made on first use, -1 if the child does not exist
+  int child_get(const int octo_id, const int child_id);
 
 public:
-  std::vector<std::shared_ptr<OctoAstarNode>> path_;
+  std::vector<Eigen::Vector3f> path_;
 
 public:
   OctoAstar(const octomap::OcTree *ocmap);
   float astar_path_distance(const Eigen::Vector3f &start_p,
                             const Eigen::Vector3f &end_p);
-  // search the node at p from top to bottom
-  std::shared_ptr<OctoNode> search_octonode(const Eigen::Vector3f &p);
+  // Same search over the precomputed free leaves of graph, which must be built
+  // from the same octomap.
+  float graph_path_distance(const LeafGraph &graph,
+                            const Eigen::Vector3f &start_p,
+                            const Eigen::Vector3f &end_p);
+  // search the node at p from top to bottom, -1 if unknown
+  int search_octonode(const Eigen::Vector3f &p);
+  const OctoNode &octo_node(const int octo_id) const {
+    return octo_nodes_[octo_id];
+  }
+  int num_octo_nodes() const { return octo_nodes_.size(); }
+  int num_astar_nodes() const { return astar_nodes_.size(); }
   inline float calc_h_score(const Eigen::Vector3f &start_p,
                             const Eigen::Vector3f &end_p);
   bool is_path_valid(const Eigen::Vector3f &cur_pos,
                      const Eigen::Vector3f &next_pos);
-  inline bool
-  add_node_to_q(const std::shared_ptr<OctoNode> &next_node,
-                const std::shared_ptr<OctoAstarNode> &cur_node,
-                const Eigen::Vector3f &end_p,
-                std::priority_queue<std::shared_ptr<OctoAstarNode>,
-                                    std::vector<std::shared_ptr<OctoAstarNode>>,
-                                    OctoAstarNodeCmp> &astar_q);
+  inline bool add_node_to_q(const int next_octo_id, const int cur_astar_id,
+                            const Eigen::Vector3f &end_p);
 };
 
 #endif
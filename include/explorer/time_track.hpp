@@ -10,6 +10,11 @@ private:
 public:
   TimeTrack() : start_time_(std::chrono::system_clock::now()){};
   void SetStartTime() { start_time_ = std::chrono::system_clock::now(); }
+  float GetPassingTime() const {
+    std::chrono::duration<float, std::milli> elapsed =
+        std::chrono::system_clock::now() - start_time_;
+    return elapsed.count();
+  }
   float OutputPassingTime(const std::string &item_name) {
     auto end_time = std::chrono::system_clock::now();
     std::chrono::duration<float, std::milli> elapsed = end_time - start_time_;
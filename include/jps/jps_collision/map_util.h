@@ -20,7 +20,11 @@ namespace JPS {
       ///Simple constructor
       MapUtil() {}
       ///Get map data
-      Tmap getMap() { return map_; }
+      Tmap getMap() { return Tmap(map_data_, map_data_ + getSize()); }
+      ///Get pointer to the map data, which may be owned by the caller
+      const signed char *getMapData() const { return map_data_; }
+      ///Get number of cells
+      int getSize() const { return dim_.prod(); }
       ///Get resolution
       decimal_t getRes() { return res_; }
       ///Get dimensions
@@ -36,11 +40,11 @@ namespace JPS {
       ///Check if the given cell is outside of the map in i-the dimension
       bool isOutsideXYZ(const Veci<Dim> &n, int i) { return n(i) < 0 || n(i) >= dim_(i); }
       ///Check if the cell is free by index
-      bool isFree(int idx) { return map_[idx] == val_free; }
+      bool isFree(int idx) { return map_data_[idx] == val_free; }
       ///Check if the cell is unknown by index
-      bool isUnknown(int idx) { return map_[idx] == val_unknown; }
+      bool isUnknown(int idx) { return map_data_[idx] == val_unknown; }
       ///Check if the cell is occupied by index
-      bool isOccupied(int idx) { return map_[idx] > val_free; }
+      bool isOccupied(int idx) { return map_data_[idx] > val_free; }
 
       ///Check if the cell is outside by coordinate
       bool isOutside(const Veci<Dim> &pn) {
@@ -67,7 +71,7 @@ namespace JPS {
       bool isUnknown(const Veci<Dim> &pn) {
         if (isOutside(pn))
           return false;
-        return map_[getIndex(pn)] == val_unknown;
+        return map_data_[getIndex(pn)] == val_unknown;
       }
 
       /**
@@ -80,6 +84,23 @@ namespace JPS {
        */
       void setMap(const Vecf<Dim>& ori, const Veci<Dim>& dim, const Tmap &map, decimal_t res) {
         map_ = map;
+        map_data_ = map_.data();
+        dim_ = dim;
+        origin_d_ = ori;
+        res_ = res;
+      }
+
+      /**
+       * @brief Set map as a view of cells owned by the caller, nothing is copied
+       *
+       * @param ori origin position
+       * @param dim number of cells in each dimension
+       * @param map array of cell values, must outlive the util
+       * @param res map resolution
+       */
+      void setMapView(const Vecf<Dim>& ori, const Veci<Dim>& dim, const signed char *map, decimal_t res) {
+        map_.clear();
+        map_data_ = map;
         dim_ = dim;
         origin_d_ = ori;
         res_ = res;
@@ -134,7 +155,7 @@ namespace JPS {
       bool isBlocked(const Vecf<Dim>& p1, const Vecf<Dim>& p2, int8_t val = 100) {
         vec_Veci<Dim> pns = rayTrace(p1, p2);
         for (const auto &pn : pns) {
-          if (map_[getIndex(pn)] >= val)
+          if (map_data_[getIndex(pn)] >= val)
             return true;
         }
         return false;
@@ -220,7 +241,7 @@ namespace JPS {
 
       ///Dilate occupied cells
       void dilate(const vec_Veci<Dim>& dilate_neighbor) {
-        Tmap map = map_;
+        Tmap map = getMap();
         Veci<Dim> n = Veci<Dim>::Zero();
         if(Dim == 3) {
           for (n(0) = 0; n(0) < dim_(0); n(0)++) {
@@ -250,10 +271,15 @@ namespace JPS {
         }
 
         map_ = map;
+        map_data_ = map_.data();
       }
 
       ///Free unknown voxels
       void freeUnknown() {
+        if (map_data_ != map_.data()) {
+          map_ = getMap();
+          map_data_ = map_.data();
+        }
         Veci<Dim> n;
         if(Dim == 3) {
           for (n(0) = 0; n(0) < dim_(0); n(0)++) {
@@ -278,6 +304,8 @@ namespace JPS {
       ///Map entity
       Tmap map_;
     protected:
+      ///Cells of the map, points to map_ or to the data of a view
+      const signed char *map_data_ = nullptr;
       ///Resolution
       decimal_t res_;
       ///Origin, float type
@@ -7,10 +7,12 @@
 #define JPS_GRAPH_SEARCH_H
 
 #include <boost/heap/d_ary_heap.hpp>      // boost::heap::d_ary_heap
+#include <cstdint>                        // uint64_t
 #include <memory>                         // std::shared_ptr
 #include <limits>                         // std::numeric_limits
 #include <vector>                         // std::vector
 #include <unordered_map>                  // std::unordered_map
+#include <jps_planner/jps_planner/jump_table.h>
 
 namespace JPS
 {
@@ -189,6 +191,9 @@ namespace JPS
        */
       bool plan(int xStart, int yStart, int zStart, int xGoal, int yGoal, int zGoal, bool useJps, int maxExpand = -1);
 
+      /// Read the 3D straight jumps from a table built on the same map, nullptr to scan the map
+      void setJumpTable(const JumpTable* table);
+
       /// Get the optimal path
       std::vector<StatePtr> getPath() const;
 
@@ -240,6 +245,12 @@ namespace JPS
       bool jump(int x, int y, int dx, int dy, int& new_x, int& new_y);
       /// 3D jump, return true iff finding the goal or a jump point
       bool jump(int x, int y, int z, int dx, int dy, int dz, int& new_x, int& new_y, int& new_z);
+      /// 3D straight jump along x, scans 64 cells of the row at a time
+      bool jumpX(int x, int y, int z, int dx, int& new_x, int& new_y, int& new_z);
+      /// Build the bit words of the row (y, z) along x
+      void initRowBits(int y, int z);
+      /// 3D straight jump read from the jump table
+      bool jumpTable(int x, int y, int z, int dx, int dy, int dz, int& new_x, int& new_y, int& new_z);
 
       /// Initialize 2D jps arrays
       void init2DJps();
@@ -260,6 +271,17 @@ namespace JPS
 
       std::vector<StatePtr> path_;
 
+      /// Number of 64-bit words of a row along x
+      int row_words_ = 0;
+      /// Per row (y, z), bit x is set if the cell (x, y, z) is free
+      std::vector<uint64_t> free_bits_;
+      /// Per row (y, z), bit x is set if the cell (x, y, z) is occupied
+      std::vector<uint64_t> occ_bits_;
+      /// Flags of the rows whose bits have been built
+      std::vector<bool> row_ready_;
+      /// Precomputed straight jumps, not owned
+      const JumpTable* jump_table_ = nullptr;
+
       std::vector<std::vector<int>> ns_;
       std::shared_ptr<JPS2DNeib> jn2d_;
       std::shared_ptr<JPS3DNeib> jn3d_;
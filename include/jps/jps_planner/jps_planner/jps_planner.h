@@ -43,6 +43,13 @@ class JPSPlanner
     vec_Vecf<Dim> removeCornerPts(const vec_Vecf<Dim> &path);
     ///Must be called before run the planning thread
     void updateMap();
+    ///Plan on the cells of the map util without copying, it can be called
+    ///instead of updateMap when occupied cells are positive and the other
+    ///cells are free (0) or unknown (negative, not traversable)
+    void updateMapView();
+    ///Read the straight jumps of 3D planning from a table built on the map
+    ///data of the planner, nullptr to scan the map
+    void setJumpTable(const std::shared_ptr<JPS::JumpTable>& jump_table);
     ///Planning function
     bool plan(const Vecf<Dim> &start, const Vecf<Dim> &goal, decimal_t eps = 1, bool use_jps = true);
     ///Get the nodes in open set
@@ -66,6 +73,10 @@ class JPSPlanner
     bool planner_verbose_;
     ///1-D map array
     std::vector<char> cmap_;
+    ///Map used by the graph search, points to cmap_ or to the map util
+    const char *cmap_data_ = nullptr;
+    ///Precomputed straight jumps, optional
+    std::shared_ptr<JPS::JumpTable> jump_table_;
 };
 
 ///Planner for 2D OccMap
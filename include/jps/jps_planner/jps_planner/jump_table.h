@@ -0,0 +1,70 @@
+/**
+ * @file jump_table.h
+ * @brief Precomputed jump distances of straight moves (JPS+)
+ */
+#ifndef JPS_JUMP_TABLE_H
+#define JPS_JUMP_TABLE_H
+
+#include <cstdint>                        // uint8_t
+#include <vector>                         // std::vector
+
+namespace JPS
+{
+  /**
+   * @brief Jump distances of the 6 straight moves in a 3D map
+   *
+   * For every cell and direction, the table stores the number of steps to the
+   * next cell that stops a straight jump: a cell that is not free, or a cell
+   * with a forced neighbor. The goal is not part of the table, the search
+   * checks it on the line.
+   */
+  class JumpTable
+  {
+    public:
+      ///Simple constructor
+      JumpTable() {}
+      /**
+       * @brief Compute the distances of all cells
+       *
+       * @param cMap 1D array stores the occupancy, with the order equal to \f$x + xDim * y + xDim * yDim * z\f$, must outlive the table
+       * @param xDim map length
+       * @param yDim map width
+       * @param zDim map height
+       */
+      void build(const char* cMap, int xDim, int yDim, int zDim);
+      /**
+       * @brief Recompute the distances after the cells in [min, max] changed
+       *
+       * Only the lines passing through the box, or next to it, are recomputed.
+       */
+      void update(int x_min, int y_min, int z_min, int x_max, int y_max, int z_max);
+      ///Check if the table is built on the map cMap
+      bool matches(const char* cMap, int xDim, int yDim, int zDim) const;
+      /**
+       * @brief Number of steps from (x, y, z) to the next stop along (dx, dy, dz)
+       *
+       * The move must have a single non-zero component equal to 1 or -1.
+       */
+      int distance(int x, int y, int z, int dx, int dy, int dz) const;
+
+    private:
+      ///Recompute the distances of the line along axis through coord
+      void buildLine(int axis, const int coord[3]);
+
+      ///Distances saturate at kMaxStep, the search then hops kMaxStep - 1
+      ///cells and reads again
+      static constexpr int kMaxStep = 255;
+
+      const char* cMap_ = nullptr;
+      const char val_free_ = 0;
+      int dim_[3] = {0, 0, 0};
+      ///Index step of each axis
+      int stride_[3] = {0, 0, 0};
+      ///Distances of direction 2 * axis (positive) and 2 * axis + 1 (negative)
+      std::vector<uint8_t> dist_[6];
+      ///Buffers of a line
+      std::vector<char> line_stop_;
+      std::vector<int> line_dist_;
+  };
+}
+#endif
@@ -9,7 +9,7 @@
 #include <string>
 #include <unordered_map>
 
-float Astar::astar_path_distance(const octomap::OcTree *ocmap,
+float Astar::astar_path_distance(const LocalMap &local_map,
                                  const Eigen::Vector3f &start_p,
                                  const Eigen::Vector3f &end_p) {
   vector<Eigen::Vector3f> expand_offset = {{0.2, 0.0, 0.0}, {-0.2, 0.0, 0.0},
@@ -75,7 +75,8 @@ float Astar::astar_path_distance(const octomap::OcTree *ocmap,
         continue;
       }
 
-      bool is_next_node_valid = is_path_valid(ocmap, node.position_, next_pos);
+      bool is_next_node_valid =
+          is_path_valid(local_map, node.position_, next_pos);
       if (!is_next_node_valid) {
         continue;
       }
@@ -140,20 +141,9 @@ float Astar::calc_h_score(const Eigen::Vector3f &start_p,
   return abs(delta.x()) + abs(delta.y()) + 10.0 * abs(delta.z());
 }
 
-bool Astar::is_path_valid(const octomap::OcTree *ocmap,
+bool Astar::is_path_valid(const LocalMap &local_map,
                           const Eigen::Vector3f &cur_pos,
                           const Eigen::Vector3f &next_pos) {
-  octomap::OcTreeNode *oc_node =
-      ocmap->search(next_pos.x(), next_pos.y(), next_pos.z());
-  if (oc_node == nullptr) {
-    // cout << "unknown" << endl;
-    return false;
-  }
-
-  if (oc_node != nullptr && ocmap->isNodeOccupied(oc_node)) {
-    // cout << "occ" << endl;
-    return false;
-  }
-
-  return true;
+  // unknown and occupied voxels are both invalid
+  return local_map.GetState(next_pos) == LocalMap::VoxelState::kFree;
 }
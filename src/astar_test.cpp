@@ -79,8 +79,16 @@ int main(int argc, char **argv) {
 
     // A*寻路，并统计时间
     Astar astar;
+    LocalMap local_map;
     auto start_time = std::chrono::system_clock::now();
-    astar.astar_path_distance(ocmap, start_pt, end_pt);
+    // the search is bounded to z in [0, 2.5]
+    const Eigen::Vector3f bbx_min = start_pt.cwiseMin(end_pt);
+    const Eigen::Vector3f bbx_max = start_pt.cwiseMax(end_pt);
+    local_map.Update(ocmap,
+                     Eigen::Vector3f(bbx_min.x() - 2.0, bbx_min.y() - 2.0, 0.0),
+                     Eigen::Vector3f(bbx_max.x() + 2.0, bbx_max.y() + 2.0, 2.5),
+                     false);
+    astar.astar_path_distance(local_map, start_pt, end_pt);
     auto end_time = std::chrono::system_clock::now();
     std::chrono::duration<float, std::milli> elapsed = end_time - start_time;
     std::cout << "[astar search] :" << elapsed.count() << " ms" << std::endl;
@@ -1,5 +1,6 @@
 #include "explorer/block.h"
 #include "explorer/time_track.hpp"
+#include <algorithm>
 #include <cmath>
 
 Block2D::Block2D(const int y, const RangeVoxel &range)
@@ -69,20 +70,6 @@ std::vector<Block2D> Block2D::GetOverlap(const Block2D &block) const {
   return overlapped_blocks;
 }
 
-float Block2D::GetRoughDistance(const Block2D &block, const int delta_x) const {
-  // std::vector<Block2D> overlapped_blocks = GetOverlap(block);
-  // if (overlapped_blocks.empty()) {
-  //   int delta_y = 0.5 * (y_max_ + y_min_ - block.y_max_ - block.y_min_);
-  //   int delta_z = 0.5 * (z_max_ + z_min_ - block.z_max_ - block.z_min_);
-  //   return std::hypot(delta_x, delta_y, delta_z);
-  // } else {
-  //   return std::abs(static_cast<float>(delta_x));
-  // }
-  int delta_y = 0.5 * (y_max_ + y_min_ - block.y_max_ - block.y_min_);
-  int delta_z = 0.5 * (z_max_ + z_min_ - block.z_max_ - block.z_min_);
-  return std::hypot(delta_x, delta_y, delta_z);
-}
-
 bool Block2D::GetRangeAtY(const int y, RangeVoxel *range) const {
   if (y < y_min_ || y > y_max_) {
     return false;
@@ -131,3 +118,53 @@ Block3DWrapper::Block3DWrapper(const Block3D &block_3d, const Block2D &plug,
     : block_3d_(block_3d), plug_(plug) {
   block_3d_.block_id_ = block_id;
 }
+
+void BlockIndex::Resize(const int num_x, const int num_y) {
+  num_y_ = num_y;
+  column_offsets_.assign(num_x, std::vector<int>(num_y + 1, 0));
+  column_ranges_.assign(num_x, std::vector<RangeVoxel>());
+  column_ids_.assign(num_x, std::vector<int>());
+}
+
+void BlockIndex::UpdateSlice(const int x, const std::vector<Block2D> &blocks,
+                             const std::vector<int> &block_ids) {
+  std::vector<int> &offsets = column_offsets_[x];
+  offsets.assign(num_y_ + 1, 0);
+  // Count the ranges in each column.
+  for (const Block2D &block : blocks) {
+    const int y_max = std::min(block.y_max_, num_y_ - 1);
+    for (int y = std::max(block.y_min_, 0); y <= y_max; ++y) {
+      ++offsets[y + 1];
+    }
+  }
+  for (int y = 0; y < num_y_; ++y) {
+    offsets[y + 1] += offsets[y];
+  }
+  column_ranges_[x].resize(offsets[num_y_]);
+  column_ids_[x].resize(offsets[num_y_]);
+  std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+  const int num_blocks = blocks.size();
+  for (int j = 0; j < num_blocks; ++j) {
+    const Block2D &block = blocks[j];
+    const int y_max = std::min(block.y_max_, num_y_ - 1);
+    for (int y = std::max(block.y_min_, 0); y <= y_max; ++y) {
+      column_ranges_[x][cursor[y]] = block.ranges_[y - block.y_min_];
+      column_ids_[x][cursor[y]] = block_ids[j];
+      ++cursor[y];
+    }
+  }
+}
+
+int BlockIndex::GetBlockId(const int x, const int y, const int z) const {
+  if (x < 0 || x >= column_offsets_.size() || y < 0 || y >= num_y_) {
+    return -1;
+  }
+  const std::vector<int> &offsets = column_offsets_[x];
+  for (int i = offsets[y]; i < offsets[y + 1]; ++i) {
+    const RangeVoxel &range = column_ranges_[x][i];
+    if (z >= range.min_ && z <= range.max_) {
+      return column_ids_[x][i];
+    }
+  }
+  return -1;
+}
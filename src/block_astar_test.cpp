@@ -6,6 +6,7 @@
 #include <fstream>
 #include <geometry_msgs/Point.h>
 #include <iostream>
+#include <omp.h>
 #include <random>
 #include <ros/ros.h>
 #include <visualization_msgs/Marker.h>
@@ -169,6 +170,25 @@ int main(int argc, char **argv) {
   GridAstar grid_astar(min_x, max_x, min_y, max_y, min_z, max_z, resolution,
                        grid);
 
+  // Scaling of the block decomposition with the number of threads.
+  const int max_threads = omp_get_max_threads();
+  for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+    omp_set_num_threads(num_threads);
+    GridAstar bench_astar(min_x, max_x, min_y, max_y, min_z, max_z, resolution,
+                          grid);
+    const std::string suffix = " (" + std::to_string(num_threads) + " threads)";
+    TimeTrack bench_track;
+    bench_astar.MergeMap();
+    bench_track.OutputPassingTime("Merge Map" + suffix);
+    bench_track.SetStartTime();
+    bench_astar.MergeMap2D();
+    bench_track.OutputPassingTime("Merge Map2D" + suffix);
+    bench_track.SetStartTime();
+    bench_astar.MergeMap3D();
+    bench_track.OutputPassingTime("Merge Map3D" + suffix);
+  }
+  omp_set_num_threads(max_threads);
+
   visualization_msgs::Marker waypoint;
   waypoint.header.frame_id = "map";
   waypoint.header.stamp = ros::Time::now();
@@ -508,8 +528,17 @@ int main(int argc, char **argv) {
 
     // A*寻路，并统计时间
     track.SetStartTime();
-    grid_astar.AstarPathDistance(start_pt, end_pt);
+    const GridAstarOutput astar_output =
+        grid_astar.AstarPathDistance(start_pt, end_pt);
     track.OutputPassingTime("--Astar Search Total--");
+
+    // JPS寻路，并统计时间
+    track.SetStartTime();
+    const GridAstarOutput jps_output =
+        grid_astar.JpsPathDistance(start_pt, end_pt);
+    track.OutputPassingTime("--JPS Search Total--");
+    std::cout << "Astar Path Length: " << astar_output.path_length
+              << ", JPS Path Length: " << jps_output.path_length << std::endl;
     // 可视化轨迹
     waypoint.points.clear();
     waypoint.color.r = 1.0;
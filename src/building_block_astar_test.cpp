@@ -6,6 +6,7 @@
 #include <fstream>
 #include <geometry_msgs/Point.h>
 #include <iostream>
+#include <omp.h>
 #include <random>
 #include <ros/ros.h>
 #include <visualization_msgs/Marker.h>
@@ -460,6 +461,193 @@ int main(int argc, char **argv) {
   GridAstar grid_astar(min_x, max_x, min_y, max_y, min_z, max_z, resolution,
                        grid);
 
+  // Scaling of the block decomposition with the number of threads.
+  const int max_threads = omp_get_max_threads();
+  for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+    omp_set_num_threads(num_threads);
+    GridAstar bench_astar(min_x, max_x, min_y, max_y, min_z, max_z, resolution,
+                          grid);
+    const std::string suffix = " (" + std::to_string(num_threads) + " threads)";
+    TimeTrack bench_track;
+    bench_astar.MergeMap();
+    bench_track.OutputPassingTime("Merge Map" + suffix);
+    bench_track.SetStartTime();
+    bench_astar.MergeMap2D();
+    bench_track.OutputPassingTime("Merge Map2D" + suffix);
+    bench_track.SetStartTime();
+    bench_astar.MergeMap3D();
+    bench_track.OutputPassingTime("Merge Map3D" + suffix);
+  }
+  omp_set_num_threads(max_threads);
+
+  // Sweep start/goal pairs on all floors to compare the searches on the block
+  // graph.
+  grid_astar.MergeMap();
+  grid_astar.MergeMap2D();
+  grid_astar.MergeMap3D();
+  {
+    const int num_sweep = 200;
+    std::uniform_real_distribution<float> sweep_xy(min_x, max_x);
+    std::uniform_int_distribution<int> sweep_floor(0, num_floors - 1);
+    std::vector<std::pair<Eigen::Vector3f, Eigen::Vector3f>> sweep_pairs;
+    while (sweep_pairs.size() < num_sweep) {
+      const Eigen::Vector3f start_pt = {
+          sweep_xy(gen), sweep_xy(gen),
+          (sweep_floor(gen) + 0.5f) * floor_height * resolution};
+      const Eigen::Vector3f end_pt = {
+          sweep_xy(gen), sweep_xy(gen),
+          (sweep_floor(gen) + 0.5f) * floor_height * resolution};
+      const int start_x = (start_pt.x() - min_x) / resolution;
+      const int start_y = (start_pt.y() - min_y) / resolution;
+      const int start_z = (start_pt.z() - min_z) / resolution;
+      const int end_x = (end_pt.x() - min_x) / resolution;
+      const int end_y = (end_pt.y() - min_y) / resolution;
+      const int end_z = (end_pt.z() - min_z) / resolution;
+      if (grid[start_x][start_y][start_z] == GridAstar::GridState::kOcc ||
+          grid[end_x][end_y][end_z] == GridAstar::GridState::kOcc) {
+        continue;
+      }
+      sweep_pairs.emplace_back(start_pt, end_pt);
+    }
+    std::vector<float> dijkstra_length(num_sweep, 0.0);
+    std::vector<float> astar_length(num_sweep, 0.0);
+    std::vector<float> bi_astar_length(num_sweep, 0.0);
+    TimeTrack sweep_track;
+    for (int i = 0; i < num_sweep; ++i) {
+      dijkstra_length[i] = grid_astar.BlockPathDistance(
+          sweep_pairs[i].first, sweep_pairs[i].second, false);
+    }
+    const float dijkstra_time = sweep_track.OutputPassingTime("Block Dijkstra");
+    sweep_track.SetStartTime();
+    for (int i = 0; i < num_sweep; ++i) {
+      astar_length[i] = grid_astar.BlockPathDistance(sweep_pairs[i].first,
+                                                     sweep_pairs[i].second);
+    }
+    const float astar_time = sweep_track.OutputPassingTime("Block Astar");
+    sweep_track.SetStartTime();
+    for (int i = 0; i < num_sweep; ++i) {
+      bi_astar_length[i] = grid_astar.BidirectionalBlockPathDistance(
+          sweep_pairs[i].first, sweep_pairs[i].second);
+    }
+    const float bi_astar_time =
+        sweep_track.OutputPassingTime("Bidirectional Block Astar");
+    int num_mismatch = 0;
+    for (int i = 0; i < num_sweep; ++i) {
+      if (std::fabs(astar_length[i] - dijkstra_length[i]) > 1e-2 ||
+          std::fabs(bi_astar_length[i] - dijkstra_length[i]) > 1e-2) {
+        ++num_mismatch;
+      }
+    }
+    std::cout << "[Sweep] " << num_sweep << " pairs, Dijkstra: "
+              << dijkstra_time << " ms, Astar: " << astar_time
+              << " ms, Bidirectional Astar: " << bi_astar_time
+              << " ms, length mismatch: " << num_mismatch << std::endl;
+
+    // Latency of the path refinement on the same pairs.
+    float refine_time_sum = 0.0;
+    float refine_time_max = 0.0;
+    for (int i = 0; i < num_sweep; ++i) {
+      grid_astar.BlockPathDistance(sweep_pairs[i].first, sweep_pairs[i].second);
+      TimeTrack refine_track;
+      grid_astar.BlockPathRefine(grid_astar.block_path(), sweep_pairs[i].first,
+                                 sweep_pairs[i].second);
+      const float refine_time = refine_track.GetPassingTime();
+      refine_time_sum += refine_time;
+      refine_time_max = std::max(refine_time_max, refine_time);
+    }
+    std::cout << "[Refine Sweep] " << num_sweep
+              << " pairs, mean: " << refine_time_sum / num_sweep
+              << " ms, worst: " << refine_time_max << " ms" << std::endl;
+
+    // JPS on the voxel grid, a subset of the pairs since each query is long.
+    const int num_jps = 20;
+    int num_jps_success = 0;
+    float jps_time_max = 0.0;
+    std::vector<float> jps_length(num_jps, 0.0);
+    TimeTrack jps_sweep_track;
+    for (int i = 0; i < num_jps; ++i) {
+      TimeTrack jps_track;
+      const GridAstarOutput jps_output = grid_astar.JpsPathDistance(
+          sweep_pairs[i].first, sweep_pairs[i].second);
+      jps_time_max = std::max(jps_time_max, jps_track.GetPassingTime());
+      jps_length[i] = jps_output.path_length;
+      if (jps_output.success) {
+        ++num_jps_success;
+      }
+    }
+    const float jps_time = jps_sweep_track.GetPassingTime();
+    std::cout << "[JPS Sweep] " << num_jps
+              << " pairs, mean: " << jps_time / num_jps
+              << " ms, worst: " << jps_time_max
+              << " ms, success: " << num_jps_success << std::endl;
+
+    // Same pairs with the precomputed jump table (JPS+).
+    jps_sweep_track.SetStartTime();
+    grid_astar.EnableJumpTable();
+    const float jump_table_time =
+        jps_sweep_track.OutputPassingTime("Jump Table Build");
+    int num_jps_mismatch = 0;
+    jps_sweep_track.SetStartTime();
+    for (int i = 0; i < num_jps; ++i) {
+      const GridAstarOutput jps_output = grid_astar.JpsPathDistance(
+          sweep_pairs[i].first, sweep_pairs[i].second);
+      if (std::fabs(jps_output.path_length - jps_length[i]) > 1e-3) {
+        ++num_jps_mismatch;
+      }
+    }
+    const float jps_table_time = jps_sweep_track.GetPassingTime();
+    grid_astar.DisableJumpTable();
+    std::cout << "[JPS+ Sweep] " << num_jps
+              << " pairs, build: " << jump_table_time
+              << " ms, mean: " << jps_table_time / num_jps
+              << " ms, speedup: " << jps_time / jps_table_time
+              << ", length mismatch: " << num_jps_mismatch << std::endl;
+  }
+
+  // Cost matrix between viewpoints on the block graph.
+  for (const int num_viewpoints : {20, 50, 100}) {
+    std::uniform_real_distribution<float> viewpoint_xy(min_x, max_x);
+    std::uniform_int_distribution<int> viewpoint_floor(0, num_floors - 1);
+    std::vector<Eigen::Vector3f> viewpoints;
+    while (viewpoints.size() < num_viewpoints) {
+      const Eigen::Vector3f viewpoint = {
+          viewpoint_xy(gen), viewpoint_xy(gen),
+          (viewpoint_floor(gen) + 0.5f) * floor_height * resolution};
+      const int x = (viewpoint.x() - min_x) / resolution;
+      const int y = (viewpoint.y() - min_y) / resolution;
+      const int z = (viewpoint.z() - min_z) / resolution;
+      if (grid[x][y][z] == GridAstar::GridState::kOcc) {
+        continue;
+      }
+      viewpoints.emplace_back(viewpoint);
+    }
+    TimeTrack matrix_track;
+    std::vector<std::vector<float>> pair_cost(
+        num_viewpoints, std::vector<float>(num_viewpoints, 0.0));
+    for (int i = 0; i < num_viewpoints; ++i) {
+      for (int j = 0; j < num_viewpoints; ++j) {
+        pair_cost[i][j] =
+            grid_astar.BlockPathDistance(viewpoints[i], viewpoints[j]);
+      }
+    }
+    const float pair_time = matrix_track.OutputPassingTime("Pairwise Astar");
+    matrix_track.SetStartTime();
+    const std::vector<std::vector<float>> cost_matrix =
+        grid_astar.BlockPathDistanceMatrix(viewpoints);
+    const float matrix_time = matrix_track.OutputPassingTime("Cost Matrix");
+    float max_error = 0.0;
+    for (int i = 0; i < num_viewpoints; ++i) {
+      for (int j = 0; j < num_viewpoints; ++j) {
+        max_error =
+            std::max(max_error, std::fabs(cost_matrix[i][j] - pair_cost[i][j]));
+      }
+    }
+    std::cout << "[Cost Matrix] " << num_viewpoints
+              << " viewpoints, pairwise: " << pair_time
+              << " ms, matrix: " << matrix_time
+              << " ms, max error: " << max_error << std::endl;
+  }
+
   visualization_msgs::Marker waypoint;
   waypoint.header.frame_id = "map";
   waypoint.header.stamp = ros::Time::now();
@@ -1,5 +1,7 @@
 #include "explorer/astar.h"
 #include "explorer/hastar.h"
+#include "explorer/local_map.h"
+#include "explorer/time_track.hpp"
 #include <geometry_msgs/PoseStamped.h>
 #include <math.h>
 #include <mavros_msgs/CommandBool.h>
@@ -138,9 +140,98 @@ private:
   mavros_msgs::CommandBool arm_cmd;
 };
 
+void hastar_run(const LocalMap &local_map, const string &scene,
+                const Eigen::Vector3f &start_p, const Eigen::Vector3f &end_p,
+                const float time_budget, const bool analytic_shot) {
+  const int num_runs = 20;
+  Hastar planning;
+  planning.time_budget = time_budget;
+  planning.analytic_shot = analytic_shot;
+  TimeTrack tracker;
+  int num_planned = 0;
+  long num_expansions = 0;
+  for (int i = 0; i < num_runs; ++i) {
+    num_planned += planning.search_path(
+        local_map, start_p + Eigen::Vector3f(0.0, 0.1 * i, 0.0), end_p, 0.0);
+    num_expansions += planning.num_expansions;
+  }
+  const float elapsed = tracker.GetPassingTime();
+  cout << "[Hastar Bench] " << scene << ", budget " << time_budget
+       << " ms, shot " << analytic_shot << ", planned " << num_planned << "/"
+       << num_runs << ", mean " << elapsed / num_runs << " ms, expansions "
+       << num_expansions / num_runs << ", traj points "
+       << planning.traj.size() << ", expansions/s "
+       << num_expansions / elapsed * 1000.0 << endl;
+}
+
+// hybrid A* on a synthetic 10 x 10 m room with a wall in the middle
+void hastar_benchmark() {
+  octomap::OcTree ocmap(0.1);
+  for (float x = 0.05; x < 10.0; x += 0.1) {
+    for (float y = 0.05; y < 10.0; y += 0.1) {
+      for (float z = 1.05; z < 2.0; z += 0.1) {
+        const bool is_wall = x > 4.5 && x < 5.0 && y < 7.0;
+        ocmap.updateNode(octomap::point3d(x, y, z), is_wall);
+      }
+    }
+  }
+  LocalMap local_map;
+  local_map.Update(&ocmap, Eigen::Vector3f(0.0, 0.0, 1.0),
+                   Eigen::Vector3f(10.0, 10.0, 2.0));
+
+  // Along the open side of the room, then around the wall. Unbounded and
+  // anytime with a budget, with and without the analytic shot.
+  const Eigen::Vector3f open_start(1.0, 7.6, 1.5);
+  const Eigen::Vector3f open_end(9.0, 8.5, 1.5);
+  const Eigen::Vector3f wall_start(2.0, 2.0, 1.5);
+  const Eigen::Vector3f wall_end(8.0, 2.0, 1.5);
+  for (const bool analytic_shot : {false, true}) {
+    hastar_run(local_map, "open", open_start, open_end, 0.0, analytic_shot);
+    hastar_run(local_map, "wall", wall_start, wall_end, 0.0, analytic_shot);
+    hastar_run(local_map, "wall", wall_start, wall_end, 80.0, analytic_shot);
+  }
+}
+
+// The analytic shot from the start of an open room crosses an unknown pocket
+// in its middle, it has to be rejected and the path go around the pocket.
+void hastar_unknown_test() {
+  octomap::OcTree ocmap(0.1);
+  for (float x = 0.05; x < 10.0; x += 0.1) {
+    for (float y = 0.05; y < 10.0; y += 0.1) {
+      for (float z = 1.05; z < 2.0; z += 0.1) {
+        const bool is_pocket = x > 4.0 && x < 6.0 && y > 3.0 && y < 7.0;
+        if (!is_pocket) {
+          ocmap.updateNode(octomap::point3d(x, y, z), false);
+        }
+      }
+    }
+  }
+  LocalMap local_map;
+  local_map.Update(&ocmap, Eigen::Vector3f(0.0, 0.0, 1.0),
+                   Eigen::Vector3f(10.0, 10.0, 2.0));
+
+  Hastar planning;
+  planning.analytic_shot = true;
+  const bool is_planned =
+      planning.search_path(local_map, Eigen::Vector3f(2.0, 5.0, 1.5),
+                           Eigen::Vector3f(8.0, 5.0, 1.5), 0.0);
+  int num_unknown = 0;
+  for (const Traj &point : planning.traj) {
+    if (local_map.GetState(point.pos) == LocalMap::VoxelState::kUnknown) {
+      num_unknown++;
+    }
+  }
+  cout << "[Hastar Unknown] planned " << is_planned << ", traj points "
+       << planning.traj.size() << ", in the unknown pocket " << num_unknown
+       << (is_planned && num_unknown == 0 ? " (ok)" : " (FAILED)") << endl;
+}
+
 int main(int argc, char **argv) {
   ros::init(argc, argv, "circle_trajectory_node");
 
+  hastar_benchmark();
+  hastar_unknown_test();
+
   CircleTrajectory circle_trajectory;
   circle_trajectory.run();
   return 0;
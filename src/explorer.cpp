@@ -2,6 +2,7 @@
 #include "explorer/frontier_cluster.h"
 #include "explorer/frontier_detector.h"
 #include "explorer/hastar.h"
+#include "explorer/local_map.h"
 #include "explorer/path_planning.h"
 #include "explorer/time_track.hpp"
 #include "lkh_ros/Solve.h"
@@ -36,6 +37,23 @@ enum CTRL_STATE { VOID = 0, POS_CTRL, YAW_CTRL };
 enum PLAN_FSM { WAIT = 0, PLAN, EXEC };
 
 Hastar planning;
+// Wall-clock budget of a hybrid A* search in ms. The best path found in time
+// is kept, or the part towards the goal to be replanned from the next pose.
+const float kPlanTimeBudget = 80.0;
+// Distance field of the hybrid A* collision checks, around the start and the
+// goal expanded by kLocalMapMargin in xy.
+const float kLocalMapMargin = 1.5;
+LocalMap local_map;
+// Occupancy cache of the frontier detection region, filled once per cycle and
+// shared by the frontier, view point and target checks.
+const float kCycleMapMargin = 0.5;
+LocalMap cycle_map;
+// Cycle map of the last frontier detection, its differences with cycle_map
+// stand for the changes of the octomap, received whole each cycle.
+LocalMap last_cycle_map;
+// The frontiers are updated from the changed voxels, and detected again in
+// the whole region every kFrontierRescanCycles cycles as a safety net.
+const int kFrontierRescanCycles = 20;
 PLAN_FSM state = PLAN_FSM::PLAN;
 tf2_ros::Buffer tf_buffer;
 
@@ -239,7 +257,13 @@ int main(int argc, char **argv) {
   history_path.type = visualization_msgs::Marker::POINTS;
 
   // frontiers
-  set<QuadMesh> frontiers;
+  FrontierSet frontiers(resolution);
+  // cycles since the last full frontier detection, 0 before the first one
+  int frontier_cycles = 0;
+  geometry_msgs::PointStamped last_frontier_pose;
+  // hybrid A* leaves the distance field through the cycle map
+  local_map.set_fallback(&cycle_map);
+  planning.time_budget = kPlanTimeBudget;
 
   // switch to offboard mode && takeoff to desired height
   offboard_takeoff(nh, 1.5);
@@ -291,9 +315,36 @@ int main(int argc, char **argv) {
     //// input = octomap; current pose; FOV; max range; region bbx
     //// output = a set containing all frontier voxels
 
+    TimeTrack cycle_tracker;
     TimeTrack tracker;
 
-    frontier_detect(frontiers, ocmap, cam_o_in_map, sensor_range);
+    if (ocmap != nullptr) {
+      // the buffers of the last map are reused
+      swap(last_cycle_map, cycle_map);
+      Eigen::Vector3f cycle_bbx_min;
+      Eigen::Vector3f cycle_bbx_max;
+      cycle_map_bbx_get(cam_o_in_map, sensor_range, kCycleMapMargin,
+                        ocmap->getResolution(), &cycle_bbx_min,
+                        &cycle_bbx_max);
+      cycle_map.Update(ocmap, cycle_bbx_min, cycle_bbx_max, false);
+      // occupancy thresholds of the is_next_to_obstacle checks
+      cycle_map.ComputeOccupancySums(0.7);
+      cycle_map.ComputeOccupancySums(0.8);
+    }
+    tracker.OutputPassingTime("Cycle Map");
+
+    tracker.SetStartTime();
+    if (ocmap != nullptr && frontier_cycles % kFrontierRescanCycles != 0) {
+      vector<octomap::OcTreeKey> changed_keys;
+      cycle_map.GetChangedKeys(last_cycle_map, &changed_keys);
+      frontier_update(frontiers, ocmap, cycle_map, cam_o_in_map,
+                      last_frontier_pose, sensor_range, changed_keys);
+      ++frontier_cycles;
+    } else {
+      frontier_detect(frontiers, ocmap, cycle_map, cam_o_in_map, sensor_range);
+      frontier_cycles = ocmap != nullptr ? 1 : 0;
+    }
+    last_frontier_pose = cam_o_in_map;
     frontier_visualize(frontiers, 0.02, frontier_maker_array_pub);
     frontier_normal_visualize(frontiers, frontier_normal_pub);
 
@@ -317,7 +368,7 @@ int main(int argc, char **argv) {
       //// generate view point
       //// input = a vector containing all frontier clusters
       //// output = a vector containing poses of all view points
-      vp_array = view_point_generate(cluster_vec, ocmap);
+      vp_array = view_point_generate(cluster_vec, cycle_map);
       view_point_pub.publish(vp_array);
       tracker.OutputPassingTime("Viewpoint Gen");
 
@@ -365,7 +416,7 @@ int main(int argc, char **argv) {
         tf2::Matrix3x3(q).getRPY(roll, pitch, yaw);
         float target_yaw = (float)yaw;
 
-        if (is_next_to_obstacle(ocmap, target_point, 0.8, 0.8)) {
+        if (is_next_to_obstacle(cycle_map, target_point, 0.8, 0.8)) {
           path_id++;
           state = PLAN_FSM::PLAN;
         } else {
@@ -373,10 +424,22 @@ int main(int argc, char **argv) {
           switch (state) {
           case PLAN_FSM::PLAN: {
             cout << "Searching Path" << endl;
+            tracker.SetStartTime();
+            const Eigen::Vector3f plan_start(cam_o_in_map.point.x,
+                                             cam_o_in_map.point.y, 1.5);
+            const Eigen::Vector3f plan_goal(
+                explore_path.poses[path_id].position.x,
+                explore_path.poses[path_id].position.y, 1.5);
+            const Eigen::Vector3f margin(kLocalMapMargin, kLocalMapMargin,
+                                         0.5);
+            local_map.Update(ocmap, plan_start.cwiseMin(plan_goal) - margin,
+                             plan_start.cwiseMax(plan_goal) + margin);
+            tracker.OutputPassingTime("Local Map");
+
             tracker.SetStartTime();
             // Hybrid A* search path
             bool is_planned = planning.search_path(
-                ocmap,
+                local_map,
                 Eigen::Vector3f(cam_o_in_map.point.x, cam_o_in_map.point.y,
                                 1.5),
                 Eigen::Vector3f(explore_path.poses[path_id].position.x,
@@ -385,20 +448,18 @@ int main(int argc, char **argv) {
             tracker.OutputPassingTime("Hybrid A*");
 
             tracker.SetStartTime();
-            // re-search
-            if (is_planned == false) {
-              is_planned = planning.search_path(
-                  ocmap,
+            // re-search from behind, reusing the expanded tree
+            if (is_planned == false && planning.is_partial == false) {
+              is_planned = planning.resume_path(
+                  local_map,
                   Eigen::Vector3f(cam_o_in_map.point.x - 0.4 * cos(cur_yaw),
                                   cam_o_in_map.point.y - 0.4 * sin(cur_yaw),
                                   1.5),
-                  Eigen::Vector3f(explore_path.poses[path_id].position.x,
-                                  explore_path.poses[path_id].position.y, 1.5),
                   cur_yaw);
             }
             tracker.OutputPassingTime("Hybrid A* Replan");
 
-            if (is_planned) {
+            if (is_planned || planning.is_partial) {
               // send traj
               explorer::Traj send_traj;
               mavros_msgs::PositionTarget target_pose;
@@ -429,11 +490,14 @@ int main(int argc, char **argv) {
               }
 
               // set target yaw at end_p
-              target_pose.yaw = target_yaw;
-              send_traj.traj.push_back(target_pose);
+              if (is_planned) {
+                target_pose.yaw = target_yaw;
+                send_traj.traj.push_back(target_pose);
+              }
 
               traj_pub.publish(send_traj);
-              state = PLAN_FSM::EXEC;
+              // a partial path is replanned in the next cycle
+              state = is_planned ? PLAN_FSM::EXEC : PLAN_FSM::PLAN;
             }
             break;
           }
@@ -450,6 +514,7 @@ int main(int argc, char **argv) {
         }
       }
     }
+    cycle_tracker.OutputPassingTime("Explore Cycle");
 
     rate.sleep();
   }
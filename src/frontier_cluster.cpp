@@ -1,13 +1,118 @@
 #include "explorer/frontier_cluster.h"
 #include "explorer/frontier_detector.h"
-#include "explorer/kd_tree.h"
+#include <cmath>
+#include <cstdint>
 #include <geometry_msgs/Pose.h>
+#include <numeric>
+#include <queue>
 #include <random>
 #include <tf2/LinearMath/Quaternion.h>
 #include <unordered_map>
 #include <visualization_msgs/MarkerArray.h>
 
-vector<Cluster> k_mean_cluster(set<QuadMesh> &frontiers) {
+namespace {
+// Points hashed in cubic cells of cell_size, the points closer than
+// cell_size to a point are in the 27 cells around its own. The cells keep
+// their neighbor cells and the points are copied in cell order.
+class PointGrid {
+public:
+  PointGrid(const vector<Eigen::Vector3f> &points, const float cell_size)
+      : points_(points), cell_factor_(1.0 / cell_size),
+        squared_cell_size_(cell_size * cell_size) {
+    const int num_points = points.size();
+    unordered_map<uint64_t, int> cell_at;
+    vector<Eigen::Vector3i> cell_keys;
+    point_cells_.resize(num_points);
+    for (int i = 0; i < num_points; i++) {
+      const Eigen::Vector3i key = CellKey(points[i]);
+      auto [cell_it, is_new] = cell_at.emplace(CellHash(key), cell_keys.size());
+      if (is_new) {
+        cell_keys.push_back(key);
+      }
+      point_cells_[i] = cell_it->second;
+    }
+    // counting sort of the points by cell
+    const int num_cells = cell_keys.size();
+    offsets_.assign(num_cells + 1, 0);
+    for (const int cell : point_cells_) {
+      offsets_[cell + 1]++;
+    }
+    partial_sum(offsets_.begin(), offsets_.end(), offsets_.begin());
+    ids_.resize(num_points);
+    cell_points_.resize(num_points);
+    vector<int> ends(offsets_.begin(), offsets_.end() - 1);
+    for (int i = 0; i < num_points; i++) {
+      const int k = ends[point_cells_[i]]++;
+      ids_[k] = i;
+      cell_points_[k] = points[i];
+    }
+    nbr_cell_offsets_.assign(1, 0);
+    for (int cell = 0; cell < num_cells; cell++) {
+      for (int dz = -1; dz <= 1; dz++) {
+        for (int dy = -1; dy <= 1; dy++) {
+          for (int dx = -1; dx <= 1; dx++) {
+            const auto cell_it = cell_at.find(
+                CellHash(cell_keys[cell] + Eigen::Vector3i(dx, dy, dz)));
+            if (cell_it != cell_at.end()) {
+              nbr_cells_.push_back(cell_it->second);
+            }
+          }
+        }
+      }
+      nbr_cell_offsets_.push_back(nbr_cells_.size());
+    }
+  }
+
+  // Visit the points closer than the cell size to point i, i included.
+  template <typename Visitor>
+  void ForEachNeighbor(const int i, Visitor &&visit) const {
+    const int cell = point_cells_[i];
+    const Eigen::Vector3f &p = points_[i];
+    for (int n = nbr_cell_offsets_[cell]; n < nbr_cell_offsets_[cell + 1];
+         n++) {
+      const int nbr_cell = nbr_cells_[n];
+      for (int k = offsets_[nbr_cell]; k < offsets_[nbr_cell + 1]; k++) {
+        const float x = cell_points_[k].x() - p.x();
+        const float y = cell_points_[k].y() - p.y();
+        const float z = cell_points_[k].z() - p.z();
+        if (x * x + y * y + z * z < squared_cell_size_) {
+          visit(ids_[k]);
+        }
+      }
+    }
+  }
+
+private:
+  // cells are offset by 2^20 to pack 21 bits per axis
+  static constexpr int kCellOffset = 1 << 20;
+
+  Eigen::Vector3i CellKey(const Eigen::Vector3f &p) const {
+    return (p * cell_factor_).array().floor().cast<int>();
+  }
+  static uint64_t CellHash(const Eigen::Vector3i &key) {
+    return static_cast<uint64_t>(key.x() + kCellOffset) |
+           (static_cast<uint64_t>(key.y() + kCellOffset) << 21) |
+           (static_cast<uint64_t>(key.z() + kCellOffset) << 42);
+  }
+
+  const vector<Eigen::Vector3f> &points_;
+  float cell_factor_;
+  float squared_cell_size_;
+  // cell of each point
+  vector<int> point_cells_;
+  // points of cell c are ids_[offsets_[c], offsets_[c + 1]), with their
+  // coordinates in cell_points_
+  vector<int> offsets_;
+  vector<int> ids_;
+  vector<Eigen::Vector3f> cell_points_;
+  // neighbor cells of cell c, c included, are
+  // nbr_cells_[nbr_cell_offsets_[c], nbr_cell_offsets_[c + 1])
+  vector<int> nbr_cell_offsets_;
+  vector<int> nbr_cells_;
+};
+} // namespace
+
+vector<Cluster> k_mean_cluster(FrontierSet &frontiers) {
   // dynamic cluster num
   const int num_frontiers = frontiers.size();
   int cluster_num = num_frontiers / 500;
@@ -16,7 +121,7 @@ vector<Cluster> k_mean_cluster(set<QuadMesh> &frontiers) {
   Eigen::Matrix3Xf frontier_center_mat(3, num_frontiers);
   Eigen::Matrix3Xf frontier_normal_mat(3, num_frontiers);
   Eigen::RowVectorXf frontier_size_mat(num_frontiers);
-  set<QuadMesh>::iterator it = frontiers.begin();
+  FrontierSet::const_iterator it = frontiers.begin();
   for (int i = 0; i < num_frontiers; i++) {
     frontier_center_mat.col(i) << it->center.x(), it->center.y(),
         it->center.z();
@@ -166,7 +271,7 @@ void cluster_visualize(vector<Cluster> &cluster_vec,
   cluster_pub.publish(marker_cluster);
 }
 
-vector<Cluster> dbscan_cluster(set<QuadMesh> &frontiers, const float &eps,
+vector<Cluster> dbscan_cluster(FrontierSet &frontiers, const float &eps,
                                const int &min_pts, const int &min_cluster_pts,
                                ros::Publisher &cluster_vis_pub) {
 
@@ -191,78 +296,111 @@ vector<Cluster> dbscan_cluster(set<QuadMesh> &frontiers, const float &eps,
 
   vector<Cluster> clusters;
 
-  vector<Point> point_array;
+  vector<Eigen::Vector3f> centers;
+  vector<Eigen::Vector3f> normals;
+  centers.reserve(frontiers.size());
+  normals.reserve(frontiers.size());
   for (auto it = frontiers.begin(); it != frontiers.end(); it++) {
-    Eigen::Vector3f normal = {it->normal.x(), it->normal.y(), it->normal.z()};
-    Point p(it->center.x(), it->center.y(), it->center.z(), normal);
-    point_array.push_back(p);
+    centers.emplace_back(it->center.x(), it->center.y(), it->center.z());
+    normals.emplace_back(it->normal.x(), it->normal.y(), it->normal.z());
   }
 
-  // build KD tree from vector
-  KdTree *frontier_kd_tree = new KdTree;
-  frontier_kd_tree->BuildTree(point_array, 0, point_array.size());
-
-  unordered_map<KdTree *, bool> is_node_visited;
-  queue<KdTree *> bfs_q;
-  bfs_q.push(frontier_kd_tree);
-
-  while (!bfs_q.empty()) {
+  const int num_points = centers.size();
+  // a search stops after more core points than this
+  const int max_cluster_pts = 500;
+  PointGrid grid(centers, eps);
+
+  // core points, with more than min_pts points within eps
+  vector<uint8_t> is_core(num_points, 0);
+#pragma omp parallel for schedule(dynamic, 256)
+  for (int i = 0; i < num_points; i++) {
+    int nbr_count = 0;
+    grid.ForEachNeighbor(i, [&](const int) { nbr_count++; });
+    is_core[i] = nbr_count > min_pts;
+  }
 
-    KdTree *node = bfs_q.front();
-    if (node->leftTree)
-      bfs_q.push(node->leftTree);
-    if (node->rightTree)
-      bfs_q.push(node->rightTree);
-    bfs_q.pop();
+  // union find of the core points within eps of each other
+  vector<int> parents(num_points);
+  iota(parents.begin(), parents.end(), 0);
+  auto find_root = [&](int i) {
+    while (parents[i] != i) {
+      parents[i] = parents[parents[i]];
+      i = parents[i];
+    }
+    return i;
+  };
+  for (int i = 0; i < num_points; i++) {
+    if (is_core[i]) {
+      grid.ForEachNeighbor(i, [&](const int nbr_id) {
+        if (nbr_id < i && is_core[nbr_id]) {
+          parents[find_root(i)] = find_root(nbr_id);
+        }
+      });
+    }
+  }
+  // core points of each component, linked from its root
+  vector<int> component_sizes(num_points, 0);
+  vector<int> first_members(num_points, -1);
+  vector<int> next_members(num_points, -1);
+  for (int i = num_points - 1; i >= 0; i--) {
+    if (is_core[i]) {
+      const int root = find_root(i);
+      component_sizes[root]++;
+      next_members[i] = first_members[root];
+      first_members[root] = i;
+    }
+  }
 
-    if (is_node_visited[node] == false) {
+  // Clusters in the order of their first core point, as the serial search.
+  // The search from a core point reaches its whole component unless it
+  // stops at max_cluster_pts, then the rest of the component is left to the
+  // next seeds. Non core points do not add to the clusters.
+  vector<bool> is_visited(num_points, false);
+  for (int seed_id = 0; seed_id < num_points; seed_id++) {
+    if (is_visited[seed_id] == false && is_core[seed_id]) {
       int count = 0;
-      queue<KdTree *> cluster_q;
-      cluster_q.push(node);
-
       Cluster cluster_candidate;
       cluster_candidate.center.setZero();
       cluster_candidate.normal.setZero();
-      while (!cluster_q.empty()) {
-
-        KdTree *cluster_node = cluster_q.front();
-        cluster_q.pop();
-        is_node_visited[cluster_node] = true;
-        priority_queue<pair<float, KdTree *>, vector<pair<float, KdTree *>>,
-                       KdTree::CustomCompare>
-            nbr_queue;
-        // kd tree search nearest point within eps
-        GetEpsNbrPoint(frontier_kd_tree, cluster_node->point, eps, nbr_queue);
-        // check this point is core point or not
-        // if it is core point: add all neighbor point to queue
-        if (nbr_queue.size() > min_pts) {
-          count++;
-          cluster_candidate.center +=
-              Eigen::Vector3f(cluster_node->point.x, cluster_node->point.y,
-                              cluster_node->point.z);
-          // cout << "node normal = " << cluster_node->point.normal.x() << ", "
-          // << cluster_node->point.normal.y() << ", " <<
-          // cluster_node->point.normal.z() << endl;
-          cluster_candidate.normal += cluster_node->point.normal;
-
-          // vis
-          geometry_msgs::Point fc;
-          fc.x = cluster_node->point.x;
-          fc.y = cluster_node->point.y;
-          fc.z = cluster_node->point.z;
-          same_type_frontier.points.push_back(fc);
-
-          while (!nbr_queue.empty()) {
-            if (is_node_visited[nbr_queue.top().second] == false) {
-              cluster_q.push(nbr_queue.top().second);
-              is_node_visited[nbr_queue.top().second] = true;
+      auto add_core_point = [&](const int id) {
+        count++;
+        cluster_candidate.center += centers[id];
+        cluster_candidate.normal += normals[id];
+
+        // vis
+        geometry_msgs::Point fc;
+        fc.x = centers[id].x();
+        fc.y = centers[id].y();
+        fc.z = centers[id].z();
+        same_type_frontier.points.push_back(fc);
+      };
+
+      const int root = find_root(seed_id);
+      // the search would count the whole component before stopping
+      if (component_sizes[root] <= max_cluster_pts + 1) {
+        for (int id = first_members[root]; id >= 0; id = next_members[id]) {
+          is_visited[id] = true;
+          add_core_point(id);
+        }
+      } else {
+        // breadth first search of the core points, capped
+        queue<int> cluster_q;
+        cluster_q.push(seed_id);
+        is_visited[seed_id] = true;
+        while (!cluster_q.empty()) {
+          const int cluster_id = cluster_q.front();
+          cluster_q.pop();
+          add_core_point(cluster_id);
+          grid.ForEachNeighbor(cluster_id, [&](const int nbr_id) {
+            if (is_core[nbr_id] && is_visited[nbr_id] == false) {
+              cluster_q.push(nbr_id);
+              is_visited[nbr_id] = true;
             }
-            nbr_queue.pop();
+          });
+          if (count > max_cluster_pts) {
+            break;
           }
         }
-        if (count > 500) {
-          break;
-        }
       }
 
       if (count >= min_cluster_pts) {
@@ -295,7 +433,7 @@ vector<Cluster> dbscan_cluster(set<QuadMesh> &frontiers, const float &eps,
 }
 
 geometry_msgs::PoseArray view_point_generate(vector<Cluster> &cluster_vec,
-                                             octomap::OcTree *ocmap) {
+                                             const LocalMap &local_map) {
   geometry_msgs::PoseArray view_point_array;
   view_point_array.header.frame_id = "map";
 
@@ -308,12 +446,13 @@ geometry_msgs::PoseArray view_point_generate(vector<Cluster> &cluster_vec,
     for (double offset = 0.8; offset < 2.5; offset += 0.1) {
       octomap::point3d view_point = center - normal.normalized() * offset;
       // view point has to be reachable
-      octomap::OcTreeNode *view_node = ocmap->search(view_point);
-      if (view_node == nullptr || view_node->getOccupancy() > 0.6) {
+      const float view_occupancy = local_map.GetOccupancy(
+          Eigen::Vector3f(view_point.x(), view_point.y(), view_point.z()));
+      if (view_occupancy < 0.0 || view_occupancy > 0.6) {
         break;
       }
       // there is no obstacle near the view point
-      if (is_next_to_obstacle(ocmap, view_point, 0.8, 0.8)) {
+      if (is_next_to_obstacle(local_map, view_point, 0.8, 0.8)) {
         continue;
       } else {
         geometry_msgs::Pose view_point_pose;
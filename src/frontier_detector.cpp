@@ -4,154 +4,505 @@
 #include <cmath>
 #include <geometry_msgs/PoseArray.h>
 #include <geometry_msgs/TransformStamped.h>
+#include <limits>
 #include <queue>
 #include <sys/time.h>
 #include <tf2/LinearMath/Quaternion.h>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <visualization_msgs/MarkerArray.h>
 
-void frontier_detect(set<QuadMesh> &frontiers, octomap::OcTree *ocmap,
+namespace {
+// check whether the point is frontier
+const octomap::point3d_collection nbr_dir = {
+    {1.0, 0.0, 0.0},  {-1.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
+    {0.0, -1.0, 0.0}, {0.0, 0.0, 1.0},  {0.0, 0.0, -1.0}};
+const octomap::point3d_collection offset = {
+    {0.0, 1.0, 1.0}, {0.0, -1.0, 1.0}, {0.0, -1.0, -1.0}, {0.0, 1.0, -1.0},
+    {1.0, 0.0, 1.0}, {-1.0, 0.0, 1.0}, {-1.0, 0.0, -1.0}, {1.0, 0.0, -1.0},
+    {1.0, 1.0, 0.0}, {-1.0, 1.0, 0.0}, {-1.0, -1.0, 0.0}, {1.0, -1.0, 0.0}};
+
+// Changed voxels are grouped in cells of kDirtyCellSize voxels. The checks of
+// a leaf or a frontier only read voxels within kDirtyMargin of it: the
+// obstacle check boxes and the face neighbors. The cells are octree nodes, so
+// the leaves split or pruned by a change stay in its cell, up to that size.
+const int kDirtyCellSize = 16;
+const double kDirtyMargin = 0.25;
+// octomap keys are offset by half the key range
+const int kKeyOffset = 32768;
+// The full region is checked in parallel by columns of kTileSize voxels,
+// aligned with the octree nodes.
+const int kTileSize = 16;
+
+// leaf of the octree to check
+struct Leaf {
+  octomap::point3d center;
+  double size;
+  int depth;
+};
+
+void check_bbx_get(const geometry_msgs::PointStamped &pose,
+                   const double &sensor_range, octomap::point3d *bbx_min,
+                   octomap::point3d *bbx_max) {
+  *bbx_min = octomap::point3d(pose.point.x - sensor_range,
+                              pose.point.y - sensor_range,
+                              max(1.0, pose.point.z - sensor_range));
+  *bbx_max = octomap::point3d(pose.point.x + sensor_range,
+                              pose.point.y + sensor_range,
+                              min(2.0, pose.point.z + sensor_range));
+}
+
+uint64_t cell_hash(const int x, const int y, const int z) {
+  return static_cast<uint64_t>(x) | (static_cast<uint64_t>(y) << 16) |
+         (static_cast<uint64_t>(z) << 32);
+}
+
+int key_get(const double coordinate, const double resolution) {
+  return static_cast<int>(floor(coordinate / resolution)) + kKeyOffset;
+}
+
+int cell_get(const double coordinate, const double resolution) {
+  return key_get(coordinate, resolution) / kDirtyCellSize;
+}
+
+// add the faces of the leaf next to unknown space to meshes, read only so
+// that leaves can be checked in parallel
+void leaf_frontier_detect(const octomap::OcTree *ocmap,
+                          const LocalMap &local_map, const Leaf &leaf,
+                          vector<QuadMesh> *meshes) {
+  const octomap::point3d &center = leaf.center;
+  const double size = leaf.size;
+  const int depth = leaf.depth;
+  // no need to check obstacles' neighbors
+  // no need to check the interior of obstacle
+  if (is_next_to_obstacle(local_map, center, 0.3, 0.8)) {
+    return;
+  }
+
+  // check 6 faces
+  for (int i = 0; i < nbr_dir.size(); i++) {
+    octomap::point3d nbr_point = center + nbr_dir[i] * size;
+    const octomap::OcTreeNode *nbr_node = ocmap->search(nbr_point, depth);
+    QuadMesh mesh;
+    if (nbr_node == nullptr) {
+      mesh.center = center + nbr_dir[i] * (size / 2.0);
+      mesh.normal = nbr_dir[i];
+      mesh.size = size;
+      meshes->push_back(mesh);
+    } else {
+      if (ocmap->nodeHasChildren(nbr_node)) {
+        // bfs search unknown voxel
+        queue<pair<octomap::point3d, int>> bfs_queue;
+        octomap::point3d surface =
+            center + nbr_dir[i] * (size / 2.0 + ocmap->getResolution() / 2.0);
+        bfs_queue.push(make_pair(surface, depth));
+
+        while (!bfs_queue.empty()) {
+          octomap::point3d point = bfs_queue.front().first;
+          int point_depth = bfs_queue.front().second;
+          double point_size = size * pow(0.5, point_depth - depth);
+          bfs_queue.pop();
+
+          const octomap::OcTreeNode *point_node =
+              ocmap->search(point, point_depth);
+          if (point_node != nullptr) {
+            if (ocmap->nodeHasChildren(point_node)) {
+              // add 4 points into queue
+              for (int offset_i = 0; offset_i < 4; offset_i++) {
+                double child_size = point_size / 2.0;
+                octomap::point3d child =
+                    point + offset[offset_i + 4 * (i / 2)] * (child_size / 2.0);
+                bfs_queue.push(make_pair(child, point_depth + 1));
+              }
+            }
+          } else {
+            mesh.center = point;
+            mesh.normal = nbr_dir[i];
+            mesh.size = point_size;
+            meshes->push_back(mesh);
+          }
+        }
+      }
+    }
+  }
+}
+
+// check the leaves in parallel, each chunk of leaves into its own buffer,
+// merged in leaf order to keep the output independent of the threads
+void leaves_frontier_detect(const octomap::OcTree *ocmap,
+                            const LocalMap &local_map,
+                            const vector<Leaf> &leaves,
+                            vector<QuadMesh> *meshes) {
+  const int kChunkSize = 16;
+  vector<vector<QuadMesh>> chunk_meshes((leaves.size() + kChunkSize - 1) /
+                                        kChunkSize);
+#pragma omp parallel for schedule(dynamic)
+  for (int c = 0; c < chunk_meshes.size(); ++c) {
+    const int end = min<int>((c + 1) * kChunkSize, leaves.size());
+    for (int i = c * kChunkSize; i < end; ++i) {
+      leaf_frontier_detect(ocmap, local_map, leaves[i], &chunk_meshes[c]);
+    }
+  }
+  for (const vector<QuadMesh> &chunk : chunk_meshes) {
+    meshes->insert(meshes->end(), chunk.begin(), chunk.end());
+  }
+}
+
+// erase the candidates next to obstacles, checked in parallel
+void near_obstacle_erase(FrontierSet &frontiers, const LocalMap &local_map,
+                         const vector<QuadMesh> &candidates) {
+  vector<char> is_near(candidates.size());
+#pragma omp parallel for schedule(dynamic, 64)
+  for (int i = 0; i < candidates.size(); ++i) {
+    is_near[i] = is_next_to_obstacle(local_map, candidates[i].center, 0.4, 0.7);
+  }
+  for (int i = 0; i < candidates.size(); ++i) {
+    if (is_near[i]) {
+      frontiers.Erase(candidates[i]);
+    }
+  }
+}
+} // namespace
+
+void frontier_detect(FrontierSet &frontiers, octomap::OcTree *ocmap,
+                     const LocalMap &local_map,
                      const geometry_msgs::PointStamped &cur_pose,
                      const double &sensor_range) {
   // check old frontier
   if (!frontiers.empty() && ocmap != nullptr) {
-    auto it = frontiers.begin();
-    while (it != frontiers.end()) {
-      // if (abs(it->center.x() - cur_pose.point.x) > sensor_range) {
-      //   it++;
-      //   continue;
-      // }
-      // if (abs(it->center.y() - cur_pose.point.y) > sensor_range) {
-      //   it++;
-      //   continue;
-      // }
-
-      if (ocmap->search(it->center) != nullptr) {
-        it = frontiers.erase(it);
-      } else {
-        it++;
-      }
-    }
+    frontiers.EraseIf([&](const QuadMesh &mesh) {
+      const Eigen::Vector3f center(mesh.center.x(), mesh.center.y(),
+                                   mesh.center.z());
+      return local_map.GetState(center) != LocalMap::VoxelState::kUnknown;
+    });
   }
 
   // add new frontier
-  // check whether the point is frontier
-  octomap::point3d_collection nbr_dir = {{1.0, 0.0, 0.0}, {-1.0, 0.0, 0.0},
-                                         {0.0, 1.0, 0.0}, {0.0, -1.0, 0.0},
-                                         {0.0, 0.0, 1.0}, {0.0, 0.0, -1.0}};
-  octomap::point3d_collection offset = {
-      {0.0, 1.0, 1.0}, {0.0, -1.0, 1.0}, {0.0, -1.0, -1.0}, {0.0, 1.0, -1.0},
-      {1.0, 0.0, 1.0}, {-1.0, 0.0, 1.0}, {-1.0, 0.0, -1.0}, {1.0, 0.0, -1.0},
-      {1.0, 1.0, 0.0}, {-1.0, 1.0, 0.0}, {-1.0, -1.0, 0.0}, {1.0, -1.0, 0.0}};
-
-  octomap::point3d check_bbx_min(cur_pose.point.x - sensor_range,
-                                 cur_pose.point.y - sensor_range,
-                                 max(1.0, cur_pose.point.z - sensor_range));
-  octomap::point3d check_bbx_max(cur_pose.point.x + sensor_range,
-                                 cur_pose.point.y + sensor_range,
-                                 min(2.0, cur_pose.point.z + sensor_range));
+  octomap::point3d check_bbx_min;
+  octomap::point3d check_bbx_max;
+  check_bbx_get(cur_pose, sensor_range, &check_bbx_min, &check_bbx_max);
 
   if (ocmap == nullptr) {
     cout << "[ERROR] the ptr of octomap is null" << endl;
   } else {
-    for (octomap::OcTree::leaf_bbx_iterator
-             it = ocmap->begin_leafs_bbx(check_bbx_min, check_bbx_max),
-             end = ocmap->end_leafs_bbx();
-         it != end; ++it) {
-      double size = it.getSize();
-      int depth = it.getDepth();
-      octomap::point3d center = it.getCoordinate();
-
-      // no need to check obstacles' neighbors
-      // no need to check the interior of obstacle
-      if (is_next_to_obstacle(ocmap, center, 0.3, 0.8)) {
-        continue;
+    // A leaf across columns is checked by the column of its first voxel in
+    // the region.
+    const double resolution = ocmap->getResolution();
+    const int tree_depth = ocmap->getTreeDepth();
+    const int key_min[2] = {key_get(check_bbx_min.x(), resolution),
+                            key_get(check_bbx_min.y(), resolution)};
+    const int key_max[2] = {key_get(check_bbx_max.x(), resolution),
+                            key_get(check_bbx_max.y(), resolution)};
+    const int num_tiles_x = key_max[0] / kTileSize - key_min[0] / kTileSize + 1;
+    const int num_tiles_y = key_max[1] / kTileSize - key_min[1] / kTileSize + 1;
+    // one buffer per tile, merged in tile order so that the frontiers are
+    // inserted in the same order whatever the threads
+    vector<vector<QuadMesh>> tile_meshes(num_tiles_x * num_tiles_y);
+#pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < num_tiles_x * num_tiles_y; ++t) {
+      const int tile[2] = {key_min[0] / kTileSize + t % num_tiles_x,
+                           key_min[1] / kTileSize + t / num_tiles_x};
+      int tile_min[2];
+      octomap::point3d bbx_min = check_bbx_min;
+      octomap::point3d bbx_max = check_bbx_max;
+      for (int axis = 0; axis < 2; ++axis) {
+        tile_min[axis] = max(tile[axis] * kTileSize, key_min[axis]);
+        const int tile_max =
+            min(tile[axis] * kTileSize + kTileSize - 1, key_max[axis]);
+        // voxel centers, away from the borders
+        bbx_min(axis) = (tile_min[axis] - kKeyOffset + 0.5) * resolution;
+        bbx_max(axis) = (tile_max - kKeyOffset + 0.5) * resolution;
       }
-
-      // check 6 faces
-      for (int i = 0; i < nbr_dir.size(); i++) {
-        octomap::point3d nbr_point = center + nbr_dir[i] * size;
-        octomap::OcTreeNode *nbr_node = ocmap->search(nbr_point, depth);
-        QuadMesh mesh;
-        if (nbr_node == nullptr) {
-          mesh.center = center + nbr_dir[i] * (size / 2.0);
-          mesh.normal = nbr_dir[i];
-          mesh.size = size;
-          frontiers.insert(mesh);
-        } else {
-          if (ocmap->nodeHasChildren(nbr_node)) {
-            // bfs search unknown voxel
-            queue<pair<octomap::point3d, int>> bfs_queue;
-            octomap::point3d surface =
-                center +
-                nbr_dir[i] * (size / 2.0 + ocmap->getResolution() / 2.0);
-            bfs_queue.push(make_pair(surface, depth));
-
-            while (!bfs_queue.empty()) {
-              octomap::point3d point = bfs_queue.front().first;
-              int point_depth = bfs_queue.front().second;
-              double point_size = size * pow(0.5, point_depth - depth);
-              bfs_queue.pop();
-
-              octomap::OcTreeNode *point_node =
-                  ocmap->search(point, point_depth);
-              if (point_node != nullptr) {
-                if (ocmap->nodeHasChildren(point_node)) {
-                  // add 4 points into queue
-                  for (int offset_i = 0; offset_i < 4; offset_i++) {
-                    double child_size = point_size / 2.0;
-                    octomap::point3d child =
-                        point +
-                        offset[offset_i + 4 * (i / 2)] * (child_size / 2.0);
-                    bfs_queue.push(make_pair(child, point_depth + 1));
-                  }
-                }
-              } else {
-                mesh.center = point;
-                mesh.normal = nbr_dir[i];
-                mesh.size = point_size;
-                frontiers.insert(mesh);
-              }
-            }
-          }
+      for (octomap::OcTree::leaf_bbx_iterator
+               it = ocmap->begin_leafs_bbx(bbx_min, bbx_max),
+               end = ocmap->end_leafs_bbx();
+           it != end; ++it) {
+        const int leaf_voxels = 1 << (tree_depth - it.getDepth());
+        const octomap::OcTreeKey leaf_key = it.getKey();
+        bool is_owned = true;
+        for (int axis = 0; axis < 2; ++axis) {
+          is_owned = is_owned && max<int>(leaf_key[axis] & -leaf_voxels,
+                                          key_min[axis]) >= tile_min[axis];
+        }
+        if (is_owned) {
+          leaf_frontier_detect(
+              ocmap, local_map,
+              {it.getCoordinate(), it.getSize(),
+               static_cast<int>(it.getDepth())},
+              &tile_meshes[t]);
         }
       }
     }
+    for (const vector<QuadMesh> &meshes : tile_meshes) {
+      for (const QuadMesh &mesh : meshes) {
+        frontiers.Insert(mesh);
+      }
+    }
   }
 
   // remove frontiers near obstacle
   if (!frontiers.empty() && ocmap != nullptr) {
-    auto it = frontiers.begin();
-    while (it != frontiers.end()) {
-      if (abs(it->center.x() - cur_pose.point.x) > sensor_range) {
-        it++;
-        continue;
+    vector<QuadMesh> in_range;
+    frontiers.ForEach(
+        [&](const octomap::point3d &bucket_min,
+            const octomap::point3d &bucket_max) {
+          return bucket_max.x() >= cur_pose.point.x - sensor_range &&
+                 bucket_min.x() <= cur_pose.point.x + sensor_range &&
+                 bucket_max.y() >= cur_pose.point.y - sensor_range &&
+                 bucket_min.y() <= cur_pose.point.y + sensor_range;
+        },
+        [&](const QuadMesh &mesh) {
+          if (abs(mesh.center.x() - cur_pose.point.x) <= sensor_range &&
+              abs(mesh.center.y() - cur_pose.point.y) <= sensor_range) {
+            in_range.push_back(mesh);
+          }
+        });
+    near_obstacle_erase(frontiers, local_map, in_range);
+  }
+}
+
+void cycle_map_bbx_get(const geometry_msgs::PointStamped &pose,
+                       const double &sensor_range, const double &margin,
+                       const double &resolution, Eigen::Vector3f *bbx_min,
+                       Eigen::Vector3f *bbx_max) {
+  octomap::point3d check_bbx_min;
+  octomap::point3d check_bbx_max;
+  check_bbx_get(pose, sensor_range, &check_bbx_min, &check_bbx_max);
+  // A leaf reaching into the box lies in the dirty cells around it, up to
+  // their size. Its changes are then seen, even outside the checked region.
+  for (int axis = 0; axis < 3; ++axis) {
+    const int cell_min = cell_get(check_bbx_min(axis) - margin, resolution);
+    const int cell_max = cell_get(check_bbx_max(axis) + margin, resolution);
+    // voxel centers, away from the borders
+    (*bbx_min)(axis) =
+        (cell_min * kDirtyCellSize - kKeyOffset + 0.5) * resolution;
+    (*bbx_max)(axis) =
+        ((cell_max + 1) * kDirtyCellSize - kKeyOffset - 0.5) * resolution;
+  }
+}
+
+void frontier_update(FrontierSet &frontiers, octomap::OcTree *ocmap,
+                     const LocalMap &local_map,
+                     const geometry_msgs::PointStamped &cur_pose,
+                     const geometry_msgs::PointStamped &last_pose,
+                     const double &sensor_range,
+                     const vector<octomap::OcTreeKey> &changed_keys) {
+  if (ocmap == nullptr) {
+    cout << "[ERROR] the ptr of octomap is null" << endl;
+    return;
+  }
+  const double resolution = ocmap->getResolution();
+  octomap::point3d check_bbx_min;
+  octomap::point3d check_bbx_max;
+  check_bbx_get(cur_pose, sensor_range, &check_bbx_min, &check_bbx_max);
+  octomap::point3d last_bbx_min;
+  octomap::point3d last_bbx_max;
+  check_bbx_get(last_pose, sensor_range, &last_bbx_min, &last_bbx_max);
+
+  // cells of the changed voxels
+  unordered_set<uint64_t> dirty_cells;
+  for (const octomap::OcTreeKey &key : changed_keys) {
+    dirty_cells.insert(cell_hash(key[0] / kDirtyCellSize,
+                                 key[1] / kDirtyCellSize,
+                                 key[2] / kDirtyCellSize));
+  }
+  // The region checked in only one of the two cycles is outside the inner box,
+  // on the sides that moved. Leaves and frontiers there are checked again.
+  octomap::point3d inner_min;
+  octomap::point3d inner_max;
+  for (int axis = 0; axis < 3; ++axis) {
+    inner_min(axis) = check_bbx_min(axis) == last_bbx_min(axis)
+                          ? -numeric_limits<float>::max()
+                          : max(check_bbx_min(axis), last_bbx_min(axis)) +
+                                kDirtyMargin;
+    inner_max(axis) = check_bbx_max(axis) == last_bbx_max(axis)
+                          ? numeric_limits<float>::max()
+                          : min(check_bbx_max(axis), last_bbx_max(axis)) -
+                                kDirtyMargin;
+  }
+  // whether the box [lo, hi] leaves the inner box
+  auto is_border = [&](const octomap::point3d &lo, const octomap::point3d &hi) {
+    for (int axis = 0; axis < 3; ++axis) {
+      if (lo(axis) < inner_min(axis) || hi(axis) > inner_max(axis)) {
+        return true;
       }
-      if (abs(it->center.y() - cur_pose.point.y) > sensor_range) {
-        it++;
-        continue;
+    }
+    return false;
+  };
+  // whether the box [lo, hi] touches a dirty cell
+  auto is_dirty = [&](const octomap::point3d &lo, const octomap::point3d &hi) {
+    for (int z = cell_get(lo.z(), resolution);
+         z <= cell_get(hi.z(), resolution); ++z) {
+      for (int y = cell_get(lo.y(), resolution);
+           y <= cell_get(hi.y(), resolution); ++y) {
+        for (int x = cell_get(lo.x(), resolution);
+             x <= cell_get(hi.x(), resolution); ++x) {
+          if (dirty_cells.count(cell_hash(x, y, z)) > 0) {
+            return true;
+          }
+        }
       }
-      if (is_next_to_obstacle(ocmap, it->center, 0.4, 0.7)) {
-        it = frontiers.erase(it);
-      } else {
-        it++;
+    }
+    return false;
+  };
+  auto is_in_range = [&](const octomap::point3d &p,
+                         const geometry_msgs::PointStamped &pose) {
+    return abs(p.x() - pose.point.x) <= sensor_range &&
+           abs(p.y() - pose.point.y) <= sensor_range;
+  };
+
+  // check old frontier, only the ones whose leaf is checked again below, that
+  // is a leaf touching the dirty cells or the border. A face whose center
+  // rounds into its own leaf, as on the lower faces, is known and only kept
+  // while the leaf adds it again.
+  // The leaves of the faces of a bucket are within max_size of it.
+  const octomap::point3d margin(kDirtyMargin, kDirtyMargin, kDirtyMargin);
+  const octomap::point3d max_size(frontiers.max_size(), frontiers.max_size(),
+                                  frontiers.max_size());
+  frontiers.EraseIf(
+      [&](const octomap::point3d &bucket_min,
+          const octomap::point3d &bucket_max) {
+        return is_border(bucket_min - max_size, bucket_max + max_size) ||
+               is_dirty(bucket_min - max_size - margin,
+                        bucket_max + max_size + margin);
+      },
+      [&](const QuadMesh &mesh) {
+        const Eigen::Vector3f center(mesh.center.x(), mesh.center.y(),
+                                     mesh.center.z());
+        const octomap::point3d leaf_center =
+            mesh.center - mesh.normal * (mesh.size / 2.0);
+        const octomap::point3d half(mesh.size / 2.0, mesh.size / 2.0,
+                                    mesh.size / 2.0);
+        return (is_border(leaf_center - half, leaf_center + half) ||
+                is_dirty(leaf_center - half - margin,
+                         leaf_center + half + margin)) &&
+               local_map.GetState(center) != LocalMap::VoxelState::kUnknown;
+      });
+
+  // add new frontier, from the leaves around the dirty cells and on the
+  // border. A large leaf touches several boxes but is checked once, any leaf
+  // in the region may be checked as frontier_detect checks them all.
+  const double cell_size = kDirtyCellSize * resolution;
+  vector<pair<octomap::point3d, octomap::point3d>> boxes;
+  for (const uint64_t cell : dirty_cells) {
+    const octomap::point3d cell_min(
+        (static_cast<int>(cell & 0xFFFF) * kDirtyCellSize - kKeyOffset) *
+            resolution,
+        (static_cast<int>((cell >> 16) & 0xFFFF) * kDirtyCellSize -
+         kKeyOffset) *
+            resolution,
+        (static_cast<int>(cell >> 32) * kDirtyCellSize - kKeyOffset) *
+            resolution);
+    const octomap::point3d cell_max(cell_min.x() + cell_size,
+                                    cell_min.y() + cell_size,
+                                    cell_min.z() + cell_size);
+    boxes.emplace_back(cell_min - margin, cell_max + margin);
+  }
+  for (int axis = 0; axis < 3; ++axis) {
+    if (inner_min(axis) > check_bbx_min(axis)) {
+      boxes.emplace_back(check_bbx_min, check_bbx_max);
+      boxes.back().second(axis) = inner_min(axis);
+    }
+    if (inner_max(axis) < check_bbx_max(axis)) {
+      boxes.emplace_back(check_bbx_min, check_bbx_max);
+      boxes.back().first(axis) = inner_max(axis);
+    }
+  }
+  vector<Leaf> leaves;
+  octomap::KeySet checked_leaves;
+  for (const auto &box : boxes) {
+    octomap::point3d bbx_min;
+    octomap::point3d bbx_max;
+    bool is_empty = false;
+    for (int axis = 0; axis < 3; ++axis) {
+      bbx_min(axis) = max(box.first(axis), check_bbx_min(axis));
+      bbx_max(axis) = min(box.second(axis), check_bbx_max(axis));
+      // the leaf iterator compares voxel keys
+      is_empty = is_empty || floor(bbx_min(axis) / resolution) >
+                                 floor(bbx_max(axis) / resolution);
+    }
+    if (is_empty) {
+      continue;
+    }
+    for (octomap::OcTree::leaf_bbx_iterator
+             it = ocmap->begin_leafs_bbx(bbx_min, bbx_max),
+             end = ocmap->end_leafs_bbx();
+         it != end; ++it) {
+      if (!checked_leaves.insert(it.getKey()).second) {
+        continue;
       }
+      leaves.push_back({it.getCoordinate(), it.getSize(),
+                        static_cast<int>(it.getDepth())});
     }
   }
+  vector<QuadMesh> meshes;
+  leaves_frontier_detect(ocmap, local_map, leaves, &meshes);
+
+  // remove frontiers near obstacle: the new ones, the ones near changed
+  // voxels and the ones out of range last time
+  vector<QuadMesh> candidates;
+  for (const QuadMesh &mesh : meshes) {
+    if (frontiers.Insert(mesh) && is_in_range(mesh.center, cur_pose)) {
+      candidates.push_back(mesh);
+    }
+  }
+  near_obstacle_erase(frontiers, local_map, candidates);
+  candidates.clear();
+  frontiers.ForEach(
+      [&](const octomap::point3d &bucket_min,
+          const octomap::point3d &bucket_max) {
+        auto is_overlap = [&](const geometry_msgs::PointStamped &pose) {
+          return bucket_max.x() >= pose.point.x - sensor_range &&
+                 bucket_min.x() <= pose.point.x + sensor_range &&
+                 bucket_max.y() >= pose.point.y - sensor_range &&
+                 bucket_min.y() <= pose.point.y + sensor_range;
+        };
+        return is_overlap(cur_pose) &&
+               (!is_in_range(bucket_min, last_pose) ||
+                !is_in_range(bucket_max, last_pose) ||
+                is_border(bucket_min - margin, bucket_max + margin) ||
+                is_dirty(bucket_min - margin, bucket_max + margin));
+      },
+      [&](const QuadMesh &mesh) {
+        if (is_in_range(mesh.center, cur_pose) &&
+            (!is_in_range(mesh.center, last_pose) ||
+             is_border(mesh.center - margin, mesh.center + margin) ||
+             is_dirty(mesh.center - margin, mesh.center + margin))) {
+          candidates.push_back(mesh);
+        }
+      });
+  near_obstacle_erase(frontiers, local_map, candidates);
 }
 
-bool is_next_to_obstacle(octomap::OcTree *ocmap, const octomap::point3d &point,
+bool is_next_to_obstacle(const LocalMap &local_map,
+                         const octomap::point3d &point,
                          const double &check_box_size, const double &occ_trs) {
-  octomap::point3d check_point(point);
+  // The samples below cover the voxels from the first one to the last one,
+  // counted at once when the local map has the sums of occ_trs.
+  double last_offset = -check_box_size / 2.0;
+  while (last_offset + 0.05 <= check_box_size / 2.0) {
+    last_offset += 0.05;
+  }
+  const int count = local_map.CountOccupancyAbove(
+      Eigen::Vector3f(point.x() - check_box_size / 2.0,
+                      point.y() - check_box_size / 2.0, point.z()),
+      Eigen::Vector3f(point.x() + last_offset, point.y() + last_offset,
+                      point.z()),
+      occ_trs);
+  if (count >= 0) {
+    return count > 0;
+  }
+
+  Eigen::Vector3f check_point(point.x(), point.y(), point.z());
   for (double x_offset = -check_box_size / 2.0;
        x_offset <= check_box_size / 2.0; x_offset += 0.05) {
     for (double y_offset = -check_box_size / 2.0;
          y_offset <= check_box_size / 2.0; y_offset += 0.05) {
       check_point.x() = point.x() + x_offset;
       check_point.y() = point.y() + y_offset;
-      octomap::OcTreeNode *result = ocmap->search(check_point);
-      if (result != nullptr && result->getOccupancy() > occ_trs) {
+      // unknown voxels have a negative occupancy
+      if (local_map.GetOccupancy(check_point) > occ_trs) {
         return true;
       }
     }
@@ -159,7 +510,7 @@ bool is_next_to_obstacle(octomap::OcTree *ocmap, const octomap::point3d &point,
   return false;
 }
 
-void frontier_visualize(set<QuadMesh> &frontiers, const double &mesh_thickness,
+void frontier_visualize(FrontierSet &frontiers, const double &mesh_thickness,
                         ros::Publisher &frontier_maker_array_pub) {
   // marker template
   visualization_msgs::Marker marker;
@@ -235,7 +586,7 @@ void frontier_visualize(set<QuadMesh> &frontiers, const double &mesh_thickness,
   frontier_maker_array_pub.publish(frontier_maker_array);
 }
 
-void frontier_normal_visualize(set<QuadMesh> &frontiers,
+void frontier_normal_visualize(FrontierSet &frontiers,
                                ros::Publisher &frontier_normal_pub) {
   geometry_msgs::PoseArray frontier_normal_array;
   frontier_normal_array.header.frame_id = "map";
@@ -0,0 +1,172 @@
+#include "explorer/frontier_set.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// octomap keys are offset by half the key range
+const int kKeyOffset = 32768;
+
+// Finalizer of MurmurHash3, the keys are packed coordinates.
+uint64_t KeyMix(uint64_t key) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  return key;
+}
+} // namespace
+
+FrontierSet::FrontierSet(const double resolution)
+    : resolution_(resolution), resolution_factor_(1.0 / resolution) {
+  slots_.assign(kMinSlots, kEmpty);
+}
+
+bool FrontierSet::Insert(const QuadMesh &mesh) {
+  const uint64_t key = KeyGet(mesh);
+  const int slot = SlotFind(key);
+  if (slots_[slot] != kEmpty) {
+    return false;
+  }
+  const int index = meshes_.size();
+  slots_[slot] = index;
+  meshes_.push_back(mesh);
+  keys_.push_back(key);
+  max_size_ = std::max(max_size_, mesh.size);
+
+  octomap::OcTreeKey bucket_key;
+  for (int axis = 0; axis < 3; ++axis) {
+    bucket_key[axis] =
+        (static_cast<int>(std::floor(mesh.center(axis) * resolution_factor_)) +
+         kKeyOffset) /
+        kBucketSize;
+  }
+  const uint64_t bucket_hash = static_cast<uint64_t>(bucket_key[0]) |
+                               (static_cast<uint64_t>(bucket_key[1]) << 16) |
+                               (static_cast<uint64_t>(bucket_key[2]) << 32);
+  auto [bucket_it, is_new] = bucket_at_.emplace(bucket_hash, buckets_.size());
+  if (is_new) {
+    buckets_.emplace_back();
+    buckets_.back().key = bucket_key;
+  }
+  Bucket &bucket = buckets_[bucket_it->second];
+  bucket_refs_.emplace_back(bucket_it->second, bucket.entries.size());
+  bucket.entries.push_back(index);
+
+  // at most half full
+  if (2 * meshes_.size() > slots_.size()) {
+    Rehash(2 * slots_.size());
+  }
+  return true;
+}
+
+bool FrontierSet::Erase(const QuadMesh &mesh) {
+  const int index = slots_[SlotFind(KeyGet(mesh))];
+  if (index == kEmpty) {
+    return false;
+  }
+  EraseAt(index);
+  return true;
+}
+
+bool FrontierSet::Contains(const QuadMesh &mesh) const {
+  return slots_[SlotFind(KeyGet(mesh))] != kEmpty;
+}
+
+void FrontierSet::Clear() {
+  max_size_ = 0.0;
+  meshes_.clear();
+  keys_.clear();
+  bucket_refs_.clear();
+  slots_.assign(kMinSlots, kEmpty);
+  buckets_.clear();
+  bucket_at_.clear();
+}
+
+uint64_t FrontierSet::KeyGet(const QuadMesh &mesh) const {
+  // Face center in half voxels. The faces next to a missing node are centered
+  // on the face and the ones found in a subdivided node are half a voxel past
+  // it, both give the key of the face.
+  uint64_t key = 0;
+  uint64_t direction = 0;
+  for (int axis = 0; axis < 3; ++axis) {
+    int64_t half_key =
+        std::llround(2.0 * mesh.center(axis) * resolution_factor_) +
+        2 * kKeyOffset;
+    if (mesh.normal(axis) > 0.5 || mesh.normal(axis) < -0.5) {
+      const int sign = mesh.normal(axis) > 0.5 ? 1 : -1;
+      direction = 2 * axis + (sign < 0);
+      if (half_key % 2 != 0) {
+        half_key -= sign;
+      }
+    }
+    key |= static_cast<uint64_t>(half_key) << (17 * axis);
+  }
+  // depth from the bottom of the tree
+  const uint64_t level = std::lround(std::log2(mesh.size * resolution_factor_));
+  return key | (direction << 51) | (level << 54);
+}
+
+int FrontierSet::SlotFind(const uint64_t key) const {
+  const int mask = slots_.size() - 1;
+  int slot = KeyMix(key) & mask;
+  while (slots_[slot] != kEmpty && keys_[slots_[slot]] != key) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+void FrontierSet::SlotErase(int slot) {
+  const int mask = slots_.size() - 1;
+  for (int next = (slot + 1) & mask; slots_[next] != kEmpty;
+       next = (next + 1) & mask) {
+    // An entry can fill the hole if the hole is between its home slot and it.
+    const int home = KeyMix(keys_[slots_[next]]) & mask;
+    if (((next - home) & mask) >= ((next - slot) & mask)) {
+      slots_[slot] = slots_[next];
+      slot = next;
+    }
+  }
+  slots_[slot] = kEmpty;
+}
+
+void FrontierSet::Rehash(const int num_slots) {
+  slots_.assign(num_slots, kEmpty);
+  for (int i = 0; i < keys_.size(); ++i) {
+    slots_[SlotFind(keys_[i])] = i;
+  }
+}
+
+void FrontierSet::EraseAt(const int index) {
+  SlotErase(SlotFind(keys_[index]));
+  // swap with the last entry of the bucket
+  const auto [bucket, position] = bucket_refs_[index];
+  std::vector<int> &entries = buckets_[bucket].entries;
+  entries[position] = entries.back();
+  bucket_refs_[entries[position]].second = position;
+  entries.pop_back();
+  // swap with the last face
+  const int last = meshes_.size() - 1;
+  if (index != last) {
+    meshes_[index] = meshes_[last];
+    keys_[index] = keys_[last];
+    bucket_refs_[index] = bucket_refs_[last];
+    slots_[SlotFind(keys_[index])] = index;
+    buckets_[bucket_refs_[index].first].entries[bucket_refs_[index].second] =
+        index;
+  }
+  meshes_.pop_back();
+  keys_.pop_back();
+  bucket_refs_.pop_back();
+}
+
+octomap::point3d FrontierSet::BucketMin(const int bucket) const {
+  const octomap::OcTreeKey &key = buckets_[bucket].key;
+  return octomap::point3d((key[0] * kBucketSize - kKeyOffset) * resolution_,
+                          (key[1] * kBucketSize - kKeyOffset) * resolution_,
+                          (key[2] * kBucketSize - kKeyOffset) * resolution_);
+}
+
+octomap::point3d FrontierSet::BucketMax(const int bucket) const {
+  const double bucket_size = kBucketSize * resolution_;
+  return BucketMin(bucket) +
+         octomap::point3d(bucket_size, bucket_size, bucket_size);
+}
@@ -2,9 +2,11 @@
 #include "explorer/frontier_cluster.h"
 #include "explorer/frontier_detector.h"
 #include "explorer/hastar.h"
+#include "explorer/local_map.h"
 #include "explorer/path_planning.h"
 #include "lkh_ros/Solve.h"
 #include <Eigen/Dense>
+#include <algorithm>
 #include <cmath>
 #include <geometry_msgs/PointStamped.h>
 #include <geometry_msgs/PoseStamped.h>
@@ -16,6 +18,7 @@
 #include <octomap/octomap.h>
 #include <octomap_msgs/Octomap.h>
 #include <octomap_msgs/conversions.h>
+#include <omp.h>
 #include <queue>
 #include <random>
 #include <ros/ros.h>
@@ -86,7 +89,39 @@ int main(int argc, char **argv) {
   marker.type = visualization_msgs::Marker::CUBE_LIST;
 
   // frontiers
-  set<QuadMesh> frontiers;
+  FrontierSet frontiers(resolution);
+  // same frontiers updated from the changed voxels, to compare
+  FrontierSet updated_frontiers(resolution);
+  // occupancy cache of the frontier detection region
+  LocalMap cycle_map;
+  LocalMap last_cycle_map;
+  geometry_msgs::PointStamped last_pose;
+  bool is_first_cycle = true;
+
+  // Clustering of 64000 synthetic frontier faces on 16 walls 2 m apart.
+  {
+    FrontierSet bench_frontiers(resolution);
+    for (int wall = 0; wall < 16; ++wall) {
+      for (int j = 0; j < 200; ++j) {
+        for (int k = 0; k < 20; ++k) {
+          QuadMesh mesh;
+          mesh.size = resolution;
+          mesh.center = octomap::point3d(2.0 * wall, (j + 0.5) * resolution,
+                                         (k + 0.5) * resolution);
+          mesh.normal = octomap::point3d(1.0, 0.0, 0.0);
+          bench_frontiers.Insert(mesh);
+        }
+      }
+    }
+    const float eps = 0.4;
+
+    const ros::Time bench_time = ros::Time::now();
+    const vector<Cluster> bench_clusters =
+        dbscan_cluster(bench_frontiers, eps, 8, 8, cluster_vis_pub);
+    cout << "[dbscan " << bench_frontiers.size() << " faces]: "
+         << (ros::Time::now() - bench_time).toSec() * 1000.0 << " ms, "
+         << bench_clusters.size() << " clusters" << endl;
+  }
 
   while (ros::ok()) {
     ros::spinOnce();
@@ -112,11 +147,70 @@ int main(int argc, char **argv) {
 
     ros::Time current_time = ros::Time::now();
 
-    frontier_detect(frontiers, ocmap, cam_o_in_map, sensor_range);
+    if (ocmap != nullptr) {
+      swap(last_cycle_map, cycle_map);
+      Eigen::Vector3f cycle_bbx_min;
+      Eigen::Vector3f cycle_bbx_max;
+      cycle_map_bbx_get(cam_o_in_map, sensor_range, 0.5,
+                        ocmap->getResolution(), &cycle_bbx_min,
+                        &cycle_bbx_max);
+      cycle_map.Update(ocmap, cycle_bbx_min, cycle_bbx_max, false);
+      // occupancy thresholds of the is_next_to_obstacle checks
+      cycle_map.ComputeOccupancySums(0.7);
+      cycle_map.ComputeOccupancySums(0.8);
+    }
+    cout << "[cycle map]: "
+         << (ros::Time::now() - current_time).toSec() * 1000.0 << " ms, ";
+
+    current_time = ros::Time::now();
+    frontier_detect(frontiers, ocmap, cycle_map, cam_o_in_map, sensor_range);
 
     ros::Duration elapsed_time = ros::Time::now() - current_time;
     cout << "[frontier detect]: " << elapsed_time.toSec() * 1000.0 << " ms, ";
     cout << "[voxel num]: " << frontiers.size() << endl;
+
+    if (ocmap != nullptr) {
+      current_time = ros::Time::now();
+      if (is_first_cycle) {
+        frontier_detect(updated_frontiers, ocmap, cycle_map, cam_o_in_map,
+                        sensor_range);
+        is_first_cycle = false;
+      } else {
+        vector<octomap::OcTreeKey> changed_keys;
+        cycle_map.GetChangedKeys(last_cycle_map, &changed_keys);
+        frontier_update(updated_frontiers, ocmap, cycle_map, cam_o_in_map,
+                        last_pose, sensor_range, changed_keys);
+        cout << "[changed voxels]: " << changed_keys.size() << ", ";
+      }
+      last_pose = cam_o_in_map;
+      cout << "[frontier update]: "
+           << (ros::Time::now() - current_time).toSec() * 1000.0 << " ms, ";
+      const bool is_same =
+          updated_frontiers.size() == frontiers.size() &&
+          all_of(updated_frontiers.begin(), updated_frontiers.end(),
+                 [&](const QuadMesh &mesh) {
+                   return frontiers.Contains(mesh);
+                 });
+      cout << "[voxel num]: " << updated_frontiers.size()
+           << (is_same ? " (same)" : " (differ)") << endl;
+    }
+
+    // Scaling of the full detection with the number of threads, from no
+    // frontiers.
+    if (ocmap != nullptr) {
+      const int max_threads = omp_get_max_threads();
+      for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        omp_set_num_threads(num_threads);
+        FrontierSet bench_frontiers(resolution);
+        current_time = ros::Time::now();
+        frontier_detect(bench_frontiers, ocmap, cycle_map, cam_o_in_map,
+                        sensor_range);
+        cout << "[frontier detect " << num_threads << " threads]: "
+             << (ros::Time::now() - current_time).toSec() * 1000.0 << " ms, ";
+      }
+      omp_set_num_threads(max_threads);
+      cout << endl;
+    }
     frontier_visualize(frontiers, 0.1, frontier_maker_array_pub);
     frontier_normal_visualize(frontiers, frontier_normal_pub);
 
@@ -127,7 +221,7 @@ int main(int argc, char **argv) {
 
     if (!frontiers.empty()) {
       cluster_vec = dbscan_cluster(frontiers, 0.4, 8, 8, cluster_vis_pub);
-      vp_array = view_point_generate(cluster_vec, ocmap);
+      vp_array = view_point_generate(cluster_vec, cycle_map);
       cout << "[frontier cluster]: "
            << (ros::Time::now() - current_time).toSec() * 1000.0 << " ms"
            << endl;
@@ -1,4 +1,5 @@
 #include <jps_planner/jps_planner/graph_search.h>
+#include <algorithm>
 #include <cmath>
 
 using namespace JPS;
@@ -35,6 +36,12 @@ GraphSearch::GraphSearch(const char* cMap, int xDim, int yDim, int zDim, double
     }
   }
   jn3d_ = std::make_shared<JPS3DNeib>();
+
+  // Row bits are built on the first straight jump along each row
+  row_words_ = (xDim_ + 63) / 64;
+  free_bits_.resize(yDim_ * zDim_ * row_words_, 0);
+  occ_bits_.resize(yDim_ * zDim_ * row_words_, 0);
+  row_ready_.resize(yDim_ * zDim_, false);
 }
 
 
@@ -384,6 +391,11 @@ bool GraphSearch::jump(int x, int y, int dx, int dy, int& new_x, int& new_y ) {
 
 
 bool GraphSearch::jump(int x, int y, int z, int dx, int dy, int dz, int& new_x, int& new_y, int& new_z) {
+  if (jump_table_ != nullptr && std::abs(dx) + std::abs(dy) + std::abs(dz) == 1)
+    return jumpTable(x, y, z, dx, dy, dz, new_x, new_y, new_z);
+  if (dy == 0 && dz == 0 && dx != 0)
+    return jumpX(x, y, z, dx, new_x, new_y, new_z);
+
   new_x = x + dx;
   new_y = y + dy;
   new_z = z + dz;
@@ -411,6 +423,104 @@ bool GraphSearch::jump(int x, int y, int z, int dx, int dy, int dz, int& new_x,
   return jump(new_x, new_y, new_z, dx, dy, dz, new_x, new_y, new_z);
 }
 
+void GraphSearch::initRowBits(int y, int z) {
+  const int row = y + z * yDim_;
+  uint64_t* free_bits = &free_bits_[row * row_words_];
+  uint64_t* occ_bits = &occ_bits_[row * row_words_];
+  const char* cells = &cMap_[coordToId(0, y, z)];
+  for (int x = 0; x < xDim_; ++x) {
+    if (cells[x] == val_free_)
+      free_bits[x >> 6] |= uint64_t(1) << (x & 63);
+    else if (cells[x] > val_free_)
+      occ_bits[x >> 6] |= uint64_t(1) << (x & 63);
+  }
+  row_ready_[row] = true;
+}
+
+bool GraphSearch::jumpX(int x, int y, int z, int dx, int& new_x, int& new_y, int& new_z) {
+  new_y = y;
+  new_z = z;
+  if (y < 0 || y >= yDim_ || z < 0 || z >= zDim_) {
+    new_x = x + dx;
+    return false;
+  }
+  // The forced neighbors of a move along x are the 8 cells around it in y, z
+  const uint64_t* occ_rows[8];
+  int num_rows = 0;
+  for (int ny = y - 1; ny <= y + 1; ++ny) {
+    for (int nz = z - 1; nz <= z + 1; ++nz) {
+      if (ny < 0 || ny >= yDim_ || nz < 0 || nz >= zDim_)
+        continue;
+      const int row = ny + nz * yDim_;
+      if (!row_ready_[row])
+        initRowBits(ny, nz);
+      if (ny != y || nz != z)
+        occ_rows[num_rows++] = &occ_bits_[row * row_words_];
+    }
+  }
+  const uint64_t* free_bits = &free_bits_[(y + z * yDim_) * row_words_];
+  auto stop_bits = [&](int w) {
+    uint64_t bits = ~free_bits[w];
+    for (int i = 0; i < num_rows; ++i)
+      bits |= occ_rows[i][w];
+    return bits;
+  };
+
+  // Find the first cell after x that is not free or has a forced neighbor,
+  // the bits past the end of the row are not free so the scan stops there
+  int stop = dx > 0 ? xDim_ : -1;
+  const int start = x + dx;
+  if (dx > 0 && start < xDim_) {
+    for (int w = start >> 6; w < row_words_; ++w) {
+      uint64_t bits = stop_bits(w);
+      if (w == start >> 6)
+        bits &= ~uint64_t(0) << (start & 63);
+      if (bits) {
+        stop = std::min((w << 6) + __builtin_ctzll(bits), xDim_);
+        break;
+      }
+    }
+  } else if (dx < 0 && start >= 0) {
+    for (int w = start >> 6; w >= 0; --w) {
+      uint64_t bits = stop_bits(w);
+      if (w == start >> 6 && (start & 63) != 63)
+        bits &= (uint64_t(1) << ((start & 63) + 1)) - 1;
+      if (bits) {
+        stop = (w << 6) + 63 - __builtin_clzll(bits);
+        break;
+      }
+    }
+  }
+
+  // All cells before the stop are free, so the goal is reached if it lies there
+  if (y == yGoal_ && z == zGoal_ && (xGoal_ - x) * dx > 0 &&
+      (stop - xGoal_) * dx > 0) {
+    new_x = xGoal_;
+    return true;
+  }
+  // The stop is either blocked, or the goal or a jump point
+  new_x = stop;
+  return isFree(new_x, y, z);
+}
+
+bool GraphSearch::jumpTable(int x, int y, int z, int dx, int dy, int dz, int& new_x, int& new_y, int& new_z) {
+  const int steps = jump_table_->distance(x, y, z, dx, dy, dz);
+  // All cells before the stop are free, so the goal is reached if it lies there
+  const int goal_steps = (xGoal_ - x) * dx + (yGoal_ - y) * dy + (zGoal_ - z) * dz;
+  if (goal_steps > 0 && goal_steps < steps && x + goal_steps * dx == xGoal_ &&
+      y + goal_steps * dy == yGoal_ && z + goal_steps * dz == zGoal_) {
+    new_x = xGoal_;
+    new_y = yGoal_;
+    new_z = zGoal_;
+    return true;
+  }
+  // The stop is either blocked, or the goal or a jump point
+  new_x = x + steps * dx;
+  new_y = y + steps * dy;
+  new_z = z + steps * dz;
+  return isFree(new_x, new_y, new_z);
+}
+
 inline bool GraphSearch::hasForced(int x, int y, int dx, int dy) {
   const int id = (dx+1)+3*(dy+1);
   for( int fn = 0; fn < 2; ++fn )
@@ -468,6 +578,10 @@ inline bool GraphSearch::hasForced(int x, int y, int z, int dx, int dy, int dz)
 }
 
 
+void GraphSearch::setJumpTable(const JumpTable* table) {
+  jump_table_ = table != nullptr && table->matches(cMap_, xDim_, yDim_, zDim_) ? table : nullptr;
+}
+
 std::vector<StatePtr> GraphSearch::getPath() const {
   return path_;
 }
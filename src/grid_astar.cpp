@@ -2,13 +2,19 @@
 #include "explorer/time_track.hpp"
 #include <Eigen/Dense>
 #include <algorithm>
+#include <limits>
+#include <numeric>
+#include <omp.h>
 #include <queue>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 
 namespace {
 constexpr float kFreeThreshold = 0.3;
 constexpr float kOccThreshold = 0.7;
+// Fraction of a grid below which a leaf border is taken on the grid.
+constexpr float kGridEpsilon = 1e-3;
 constexpr int kMapZSize = 8;
 constexpr int kMapYZSize = 128;
 constexpr int kMapXYZSize = 512;
@@ -25,8 +31,33 @@ constexpr float kBndWeight = 100.0;
 constexpr float kWeight = 0.2;
 constexpr int kMaxLineSearchIter = 10;
 constexpr int kMaxReplan = 1000;
+// Time budget of BlockPathRefine in ms.
+constexpr float kRefineTimeBudget = 50.0;
+constexpr signed char kJpsFree = 0;
+constexpr signed char kJpsOcc = 100;
 constexpr float kYBuffer = 3.0;
 constexpr float kZBuffer = 3.0;
+
+std::tuple<int, int, int, int, int, int> KeyTuple(const KeyBlock &key_block) {
+  const Block2D &block = key_block.block_;
+  return std::make_tuple(key_block.block_id_, key_block.x_, block.y_min_,
+                         block.z_min_, block.y_max_, block.z_max_);
+}
+
+bool IsSameKeyBlock(const KeyBlock &lhs, const KeyBlock &rhs) {
+  if (KeyTuple(lhs) != KeyTuple(rhs)) {
+    return false;
+  }
+  const int num_ranges = lhs.block_.ranges_.size();
+  for (int i = 0; i < num_ranges; ++i) {
+    const RangeVoxel &lhs_range = lhs.block_.ranges_[i];
+    const RangeVoxel &rhs_range = rhs.block_.ranges_[i];
+    if (lhs_range.min_ != rhs_range.min_ || lhs_range.max_ != rhs_range.max_) {
+      return false;
+    }
+  }
+  return true;
+}
 } // namespace
 
 const std::vector<Eigen::Vector3i> expand_offset = {
@@ -35,51 +66,228 @@ const std::vector<Eigen::Vector3i> expand_offset = {
 void GraphTable::AddNewEdge(const KeyBlock &src_key_block,
                             const KeyBlock &dest_key_block,
                             const float weight) {
-  int src_id = nodes_.size();
-  int dest_id = nodes_.size() + 1;
-  nodes_.emplace_back(src_key_block);
-  nodes_.emplace_back(dest_key_block);
-  // Add edge between src and dest.
-  nodes_[src_id].edges_.emplace_back(dest_id, weight);
-  nodes_[dest_id].edges_.emplace_back(src_id, weight);
+  pending_edges_.emplace_back(src_key_block, dest_key_block, weight);
 }
 
-void GraphTable::AddEdgeBetweenExistingNode(const int src_id, const int dest_id,
-                                            const float weight) {
-  nodes_[src_id].edges_.emplace_back(dest_id, weight);
+void GraphTable::Build() {
+  // Sort key blocks by block, so that key blocks in the same block are
+  // contiguous, then remove the duplicates.
+  const int num_pending_edges = pending_edges_.size();
+  std::vector<const KeyBlock *> key_blocks;
+  key_blocks.reserve(2 * num_pending_edges);
+  for (const PendingEdge &edge : pending_edges_) {
+    key_blocks.emplace_back(&edge.src_);
+    key_blocks.emplace_back(&edge.dest_);
+  }
+  const int num_key_blocks = key_blocks.size();
+  std::vector<int> order(num_key_blocks);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](const int lhs, const int rhs) {
+    return KeyTuple(*key_blocks[lhs]) < KeyTuple(*key_blocks[rhs]);
+  });
+  std::vector<int> node_index(num_key_blocks, -1);
+  nodes_.clear();
+  for (int i = 0; i < num_key_blocks; ++i) {
+    const KeyBlock *key_block = key_blocks[order[i]];
+    if (nodes_.empty() ||
+        !IsSameKeyBlock(nodes_.back().key_block_, *key_block)) {
+      nodes_.emplace_back(*key_block);
+    }
+    node_index[order[i]] = nodes_.size() - 1;
+  }
+  links_.clear();
+  links_.reserve(num_pending_edges);
+  for (int e = 0; e < num_pending_edges; ++e) {
+    links_.emplace_back(node_index[2 * e], node_index[2 * e + 1],
+                        pending_edges_[e].weight_);
+  }
+  IndexBuild();
+  // Compare with one node per edge end and explicit intra-block edges.
+  int num_intra_edges = 0;
+  for (auto it = block_begin_.begin(); it != block_begin_.end(); ++it) {
+    const int group_size = nodes_[it->second].block_end_ - it->second;
+    num_intra_edges += group_size * (group_size - 1);
+  }
+  std::cout << "[GraphTable] key blocks: " << num_key_blocks
+            << ", nodes: " << nodes_.size()
+            << ", edges: " << edges_.size() + num_intra_edges
+            << " (stored: " << edges_.size() << ")" << std::endl;
+  pending_edges_.clear();
 }
 
-void GraphTable::UpdateEdgesInSameBlock() {
-  std::unordered_map<int, std::shared_ptr<std::vector<int>>> block_group;
+void GraphTable::Patch(const int x_min, const int x_max) {
+  auto is_patched = [&](const int node) {
+    const int x = nodes_[node].key_block_.x_;
+    return x_min <= x && x <= x_max;
+  };
+  // Keep the edges into the other slices, and their key blocks.
+  links_.erase(std::remove_if(links_.begin(), links_.end(),
+                              [&](const Link &link) {
+                                return is_patched(link.dest_);
+                              }),
+               links_.end());
+  const int num_old_nodes = nodes_.size();
+  std::vector<char> is_kept(num_old_nodes, 0);
+  for (const Link &link : links_) {
+    is_kept[link.src_] = 1;
+    is_kept[link.dest_] = 1;
+  }
+  // The new key blocks may only equal the kept ones in the slices of their
+  // edges, which are sorted first among the equal key blocks.
+  const int num_pending_edges = pending_edges_.size();
+  std::vector<const KeyBlock *> key_blocks;
+  for (const PendingEdge &edge : pending_edges_) {
+    key_blocks.emplace_back(&edge.src_);
+    key_blocks.emplace_back(&edge.dest_);
+  }
+  const int num_new_key_blocks = key_blocks.size();
+  // The key blocks of the kept nodes stay in place.
+  nodes_.reserve(num_old_nodes + num_new_key_blocks);
+  std::vector<int> kept_nodes;
+  for (int i = 0; i < num_old_nodes; ++i) {
+    const int x = nodes_[i].key_block_.x_;
+    if (is_kept[i] && x_min - 1 <= x && x <= x_max) {
+      key_blocks.emplace_back(&nodes_[i].key_block_);
+      kept_nodes.emplace_back(i);
+    }
+  }
+  std::vector<int> order(key_blocks.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](const int lhs, const int rhs) {
+    return std::make_tuple(KeyTuple(*key_blocks[lhs]),
+                           lhs < num_new_key_blocks) <
+           std::make_tuple(KeyTuple(*key_blocks[rhs]),
+                           rhs < num_new_key_blocks);
+  });
+  std::vector<int> node_index(num_new_key_blocks, -1);
+  const KeyBlock *last_key_block = nullptr;
+  int last_node = -1;
+  for (const int i : order) {
+    const KeyBlock *key_block = key_blocks[i];
+    if (last_key_block == nullptr ||
+        !IsSameKeyBlock(*last_key_block, *key_block)) {
+      last_key_block = key_block;
+      if (i < num_new_key_blocks) {
+        last_node = nodes_.size();
+        nodes_.emplace_back(*key_block);
+        is_kept.emplace_back(1);
+      } else {
+        last_node = kept_nodes[i - num_new_key_blocks];
+      }
+    }
+    if (i < num_new_key_blocks) {
+      node_index[i] = last_node;
+    }
+  }
+  for (int e = 0; e < num_pending_edges; ++e) {
+    links_.emplace_back(node_index[2 * e], node_index[2 * e + 1],
+                        pending_edges_[e].weight_);
+  }
+  pending_edges_.clear();
+
+  // The nodes of a block stay together, the blocks that gain or lose nodes are
+  // moved after the others.
   const int num_nodes = nodes_.size();
-  // Group nodes by block_id.
+  std::unordered_set<int> changed_blocks;
+  for (int i = 0; i < num_nodes; ++i) {
+    if (i >= num_old_nodes || !is_kept[i]) {
+      changed_blocks.insert(nodes_[i].key_block_.block_id_);
+    }
+  }
+  std::vector<int> new_order;
+  new_order.reserve(num_nodes);
+  std::vector<std::pair<int, int>> moved_nodes;
   for (int i = 0; i < num_nodes; ++i) {
-    if (block_group.find(nodes_[i].key_block_.block_id_) == block_group.end()) {
-      block_group[nodes_[i].key_block_.block_id_] =
-          std::make_shared<std::vector<int>>();
-      block_group[nodes_[i].key_block_.block_id_]->emplace_back(i);
+    if (!is_kept[i]) {
+      continue;
+    }
+    const int block_id = nodes_[i].key_block_.block_id_;
+    if (changed_blocks.find(block_id) == changed_blocks.end()) {
+      new_order.emplace_back(i);
     } else {
-      block_group[nodes_[i].key_block_.block_id_]->emplace_back(i);
-    }
-  }
-  // Update edges between nodes in the same block.
-  for (auto it = block_group.begin(); it != block_group.end(); ++it) {
-    const int group_size = it->second->size();
-    for (int i = 0; i < group_size; ++i) {
-      for (int j = 0; j < group_size; ++j) {
-        if (i != j) {
-          const int src_index = it->second->at(i);
-          const int dest_index = it->second->at(j);
-          const KeyBlock &src_key_block = nodes_[src_index].key_block_;
-          const KeyBlock &dest_key_block = nodes_[dest_index].key_block_;
-          const float delta_x = src_key_block.x_ - dest_key_block.x_;
-          const float weight = src_key_block.block_.GetRoughDistance(
-              dest_key_block.block_, delta_x);
-          AddEdgeBetweenExistingNode(src_index, dest_index, weight);
-        }
-      }
+      moved_nodes.emplace_back(block_id, i);
     }
   }
+  std::sort(moved_nodes.begin(), moved_nodes.end());
+  for (const auto &moved_node : moved_nodes) {
+    new_order.emplace_back(moved_node.second);
+  }
+  std::vector<int> new_index(num_nodes, -1);
+  std::vector<GraphNode> nodes;
+  nodes.reserve(new_order.size());
+  for (const int i : new_order) {
+    new_index[i] = nodes.size();
+    nodes.emplace_back(std::move(nodes_[i]));
+  }
+  nodes_.swap(nodes);
+  for (Link &link : links_) {
+    link.src_ = new_index[link.src_];
+    link.dest_ = new_index[link.dest_];
+  }
+  IndexBuild();
+  std::cout << "[GraphTable] patched x: [" << x_min << ", " << x_max
+            << "], nodes: " << nodes_.size()
+            << ", stored edges: " << edges_.size() << std::endl;
+}
+
+void GraphTable::IndexBuild() {
+  const int num_nodes = nodes_.size();
+  centers_.resize(num_nodes);
+  for (int i = 0; i < num_nodes; ++i) {
+    const KeyBlock &key_block = nodes_[i].key_block_;
+    const Block2D &block = key_block.block_;
+    centers_[i] =
+        Eigen::Vector3f(key_block.x_, 0.5 * (block.y_min_ + block.y_max_),
+                        0.5 * (block.z_min_ + block.z_max_));
+  }
+  // Range of nodes in each block.
+  block_begin_.clear();
+  for (int i = 0; i < num_nodes;) {
+    const int block_id = nodes_[i].key_block_.block_id_;
+    int j = i;
+    while (j < num_nodes && nodes_[j].key_block_.block_id_ == block_id) {
+      ++j;
+    }
+    block_begin_[block_id] = i;
+    for (int k = i; k < j; ++k) {
+      nodes_[k].block_begin_ = i;
+      nodes_[k].block_end_ = j;
+    }
+    i = j;
+  }
+  // Edges between blocks in CSR form.
+  edge_offsets_.assign(num_nodes + 1, 0);
+  for (const Link &link : links_) {
+    ++edge_offsets_[link.src_ + 1];
+    ++edge_offsets_[link.dest_ + 1];
+  }
+  for (int i = 0; i < num_nodes; ++i) {
+    edge_offsets_[i + 1] += edge_offsets_[i];
+  }
+  edges_.resize(edge_offsets_[num_nodes]);
+  std::vector<int> cursor(edge_offsets_.begin(), edge_offsets_.end() - 1);
+  for (const Link &link : links_) {
+    edges_[cursor[link.src_]++] = GraphEdge(link.dest_, link.weight_);
+    edges_[cursor[link.dest_]++] = GraphEdge(link.src_, link.weight_);
+  }
+}
+
+bool GraphTable::GetBlockNodes(const int block_id, int *begin,
+                               int *end) const {
+  auto it = block_begin_.find(block_id);
+  if (it == block_begin_.end()) {
+    return false;
+  }
+  *begin = it->second;
+  *end = nodes_[it->second].block_end_;
+  return true;
+}
+
+float KeyBlock::GetDistance(const int x, const int y, const int z) const {
+  const float delta_x = x - x_;
+  const float delta_y = y - 0.5 * (block_.y_min_ + block_.y_max_);
+  const float delta_z = z - 0.5 * (block_.z_min_ + block_.z_max_);
+  return std::hypot(delta_x, delta_y, delta_z);
 }
 
 GridAstarNode::GridAstarNode(const int index_x, const int index_y,
@@ -105,6 +313,8 @@ GridAstar::GridAstar(const float min_x, const float max_x, const float min_y,
       num_x_grid,
       std::vector<std::vector<GridState>>(
           num_y_grid, std::vector<GridState>(num_z_grid, GridState::kUnknown)));
+  InitJpsMap();
+  MarkDirtyX(0, num_x_grid - 1);
 }
 
 GridAstar::GridAstar(
@@ -112,7 +322,25 @@ GridAstar::GridAstar(
     const float min_z, const float max_z, const float resolution,
     const std::vector<std::vector<std::vector<GridState>>> &grid_map)
     : min_x_(min_x), max_x_(max_x), min_y_(min_y), max_y_(max_y), min_z_(min_z),
-      max_z_(max_z), resolution_(resolution), grid_map_(grid_map) {}
+      max_z_(max_z), resolution_(resolution), grid_map_(grid_map) {
+  InitJpsMap();
+  MarkDirtyX(0, static_cast<int>(grid_map_.size()) - 1);
+}
+
+void GridAstar::InitJpsMap() {
+  const int num_x_grid = grid_map_.size();
+  const int num_y_grid = num_x_grid == 0 ? 0 : grid_map_[0].size();
+  const int num_z_grid = num_y_grid == 0 ? 0 : grid_map_[0][0].size();
+  jps_map_.resize(num_x_grid * num_y_grid * num_z_grid);
+  for (int i = 0; i < num_x_grid; ++i) {
+    for (int j = 0; j < num_y_grid; ++j) {
+      for (int k = 0; k < num_z_grid; ++k) {
+        jps_map_[i + num_x_grid * (j + num_y_grid * k)] =
+            grid_map_[i][j][k] == GridState::kFree ? kJpsFree : kJpsOcc;
+      }
+    }
+  }
+}
 
 const std::vector<std::vector<std::vector<GridAstar::GridState>>> &
 GridAstar::grid_map() const {
@@ -144,6 +372,149 @@ const std::vector<std::vector<float>> &GridAstar::ilqr_path() const {
   return ilqr_path_;
 }
 
+bool GridAstar::GetDirtyXRange(int *x_min, int *x_max) const {
+  if (dirty_x_min_ > dirty_x_max_) {
+    return false;
+  }
+  *x_min = dirty_x_min_;
+  *x_max = dirty_x_max_;
+  return true;
+}
+
+void GridAstar::MarkDirtyX(const int x_min, const int x_max) {
+  if (x_min > x_max) {
+    return;
+  }
+  if (dirty_x_min_ > dirty_x_max_) {
+    dirty_x_min_ = x_min;
+    dirty_x_max_ = x_max;
+  } else {
+    dirty_x_min_ = std::min(dirty_x_min_, x_min);
+    dirty_x_max_ = std::max(dirty_x_max_, x_max);
+  }
+}
+
+void GridAstar::ClearDirtyX() {
+  dirty_x_min_ = 0;
+  dirty_x_max_ = -1;
+}
+
+void GridAstar::MarkJumpTableDirty(const int *box_min, const int *box_max) {
+  // Without a table the changes are not needed.
+  if (jump_table_ == nullptr || box_min[0] > box_max[0]) {
+    return;
+  }
+  if (jump_dirty_min_[0] > jump_dirty_max_[0]) {
+    std::copy(box_min, box_min + 3, jump_dirty_min_);
+    std::copy(box_max, box_max + 3, jump_dirty_max_);
+    return;
+  }
+  for (int axis = 0; axis < 3; ++axis) {
+    jump_dirty_min_[axis] = std::min(jump_dirty_min_[axis], box_min[axis]);
+    jump_dirty_max_[axis] = std::max(jump_dirty_max_[axis], box_max[axis]);
+  }
+}
+
+void GridAstar::UpdateJumpTable() {
+  if (jump_dirty_min_[0] > jump_dirty_max_[0]) {
+    return;
+  }
+  jump_table_->update(jump_dirty_min_[0], jump_dirty_min_[1],
+                      jump_dirty_min_[2], jump_dirty_max_[0],
+                      jump_dirty_max_[1], jump_dirty_max_[2]);
+  jump_dirty_min_[0] = 0;
+  jump_dirty_max_[0] = -1;
+}
+
+void GridAstar::EnableJumpTable() {
+  const int num_x_grid = grid_map_.size();
+  if (num_x_grid == 0) {
+    return;
+  }
+  const int num_y_grid = grid_map_[0].size();
+  const int num_z_grid = grid_map_[0][0].size();
+  jump_table_ = std::make_shared<JPS::JumpTable>();
+  jump_table_->build(reinterpret_cast<const char *>(jps_map_.data()),
+                     num_x_grid, num_y_grid, num_z_grid);
+  jump_dirty_min_[0] = 0;
+  jump_dirty_max_[0] = -1;
+}
+
+void GridAstar::DisableJumpTable() { jump_table_.reset(); }
+
+bool GridAstar::RasterizeLeaf(const octomap::point3d &center, const float size,
+                              const float occ_probility, const int slab_x_min,
+                              const int slab_x_max, int *changed_min,
+                              int *changed_max) {
+  // Do not update the unknown node.
+  if (occ_probility >= kFreeThreshold && occ_probility <= kOccThreshold) {
+    return false;
+  }
+
+  const int num_x_grid = grid_map_.size();
+  const int num_y_grid = grid_map_[0].size();
+  const int num_z_grid = grid_map_[0][0].size();
+  GridState grid_state = occ_probility < (kFreeThreshold + kOccThreshold) * 0.5
+                             ? GridState::kFree
+                             : GridState::kOcc;
+  const float node_min_x = center.x() - size * 0.5;
+  const float node_max_x = center.x() + size * 0.5;
+  const float node_min_y = center.y() - size * 0.5;
+  const float node_max_y = center.y() + size * 0.5;
+  const float node_min_z = center.z() - size * 0.5;
+  const float node_max_z = center.z() + size * 0.5;
+
+  // The leaf covers the grids [min, max], its borders are on the grid up to
+  // float errors.
+  int min_x_index = static_cast<int>(
+      std::floor((node_min_x - min_x_) / resolution_ + kGridEpsilon));
+  int max_x_index = static_cast<int>(std::ceil(
+                        (node_max_x - min_x_) / resolution_ - kGridEpsilon)) -
+                    1;
+  int min_y_index = static_cast<int>(
+      std::floor((node_min_y - min_y_) / resolution_ + kGridEpsilon));
+  int max_y_index = static_cast<int>(std::ceil(
+                        (node_max_y - min_y_) / resolution_ - kGridEpsilon)) -
+                    1;
+  int min_z_index = static_cast<int>(
+      std::floor((node_min_z - min_z_) / resolution_ + kGridEpsilon));
+  int max_z_index = static_cast<int>(std::ceil(
+                        (node_max_z - min_z_) / resolution_ - kGridEpsilon)) -
+                    1;
+
+  // A leaf outside the grid leaves an empty range.
+  min_x_index = std::max(min_x_index, 0);
+  max_x_index = std::min(max_x_index, num_x_grid - 1);
+  min_y_index = std::max(min_y_index, 0);
+  max_y_index = std::min(max_y_index, num_y_grid - 1);
+  min_z_index = std::max(min_z_index, 0);
+  max_z_index = std::min(max_z_index, num_z_grid - 1);
+  // Only write the slices owned by the slab.
+  min_x_index = std::max(min_x_index, slab_x_min);
+  max_x_index = std::min(max_x_index, slab_x_max);
+
+  bool is_changed = false;
+  for (int i = min_x_index; i <= max_x_index; ++i) {
+    for (int j = min_y_index; j <= max_y_index; ++j) {
+      for (int k = min_z_index; k <= max_z_index; ++k) {
+        if (grid_map_[i][j][k] != grid_state) {
+          grid_map_[i][j][k] = grid_state;
+          jps_map_[i + num_x_grid * (j + num_y_grid * k)] =
+              grid_state == GridState::kFree ? kJpsFree : kJpsOcc;
+          changed_min[0] = std::min(changed_min[0], i);
+          changed_max[0] = std::max(changed_max[0], i);
+          changed_min[1] = std::min(changed_min[1], j);
+          changed_max[1] = std::max(changed_max[1], j);
+          changed_min[2] = std::min(changed_min[2], k);
+          changed_max[2] = std::max(changed_max[2], k);
+          is_changed = true;
+        }
+      }
+    }
+  }
+  return is_changed;
+}
+
 void GridAstar::UpdateFromMap(const octomap::OcTree *ocmap,
                               const octomap::point3d &bbx_min,
                               const octomap::point3d &bbx_max) {
@@ -151,69 +522,122 @@ void GridAstar::UpdateFromMap(const octomap::OcTree *ocmap,
     return;
 
   const int num_x_grid = grid_map_.size();
-  const int num_y_grid = grid_map_[0].size();
-  const int num_z_grid = grid_map_[0][0].size();
-  for (octomap::OcTree::leaf_bbx_iterator
-           it = ocmap->begin_leafs_bbx(bbx_min, bbx_max),
-           end = ocmap->end_leafs_bbx();
-       it != end; ++it) {
-    float occ_probility = it->getOccupancy();
-    // Do not update the unknown node.
-    if (occ_probility >= kFreeThreshold && occ_probility <= kOccThreshold) {
+  const int bbx_x_min = std::clamp(
+      static_cast<int>(std::floor((bbx_min.x() - min_x_) / resolution_)), 0,
+      num_x_grid - 1);
+  const int bbx_x_max = std::clamp(
+      static_cast<int>(std::ceil((bbx_max.x() - min_x_) / resolution_)), 0,
+      num_x_grid - 1);
+  if (bbx_x_min > bbx_x_max) {
+    return;
+  }
+  // Split the bbx into x-slabs. Each slab iterates the leaves overlapping it
+  // and only writes its own slices, so the slabs can be updated in parallel.
+  const int num_slabs =
+      std::min(omp_get_max_threads(), bbx_x_max - bbx_x_min + 1);
+  const int slab_size = (bbx_x_max - bbx_x_min + num_slabs) / num_slabs;
+  int changed_min[3] = {num_x_grid, std::numeric_limits<int>::max(),
+                        std::numeric_limits<int>::max()};
+  int changed_max[3] = {-1, -1, -1};
+#pragma omp parallel for schedule(static, 1)                                  \
+    reduction(min : changed_min[:3]) reduction(max : changed_max[:3])
+  for (int slab = 0; slab < num_slabs; ++slab) {
+    const int slab_x_min = bbx_x_min + slab * slab_size;
+    const int slab_x_max = std::min(slab_x_min + slab_size - 1, bbx_x_max);
+    if (slab_x_min > slab_x_max) {
       continue;
     }
+    // The slab bbx is expanded by one grid, so that float errors do not drop
+    // the leaves at the border of the slab.
+    octomap::point3d slab_bbx_min = bbx_min;
+    octomap::point3d slab_bbx_max = bbx_max;
+    slab_bbx_min.x() =
+        std::max(bbx_min.x(), min_x_ + (slab_x_min - 1) * resolution_);
+    slab_bbx_max.x() =
+        std::min(bbx_max.x(), min_x_ + (slab_x_max + 2) * resolution_);
+    for (octomap::OcTree::leaf_bbx_iterator
+             it = ocmap->begin_leafs_bbx(slab_bbx_min, slab_bbx_max),
+             end = ocmap->end_leafs_bbx();
+         it != end; ++it) {
+      RasterizeLeaf(it.getCoordinate(), static_cast<float>(it.getSize()),
+                    it->getOccupancy(), slab_x_min, slab_x_max, changed_min,
+                    changed_max);
+    }
+  }
+  MarkDirtyX(changed_min[0], changed_max[0]);
+  MarkJumpTableDirty(changed_min, changed_max);
+}
 
-    GridState grid_state =
-        occ_probility < (kFreeThreshold + kOccThreshold) * 0.5
-            ? GridState::kFree
-            : GridState::kOcc;
-    const float size = static_cast<float>(it.getSize());
-    const octomap::point3d center = it.getCoordinate();
-    const float node_min_x = center.x() - size * 0.5;
-    const float node_max_x = center.x() + size * 0.5;
-    const float node_min_y = center.y() - size * 0.5;
-    const float node_max_y = center.y() + size * 0.5;
-    const float node_min_z = center.z() - size * 0.5;
-    const float node_max_z = center.z() + size * 0.5;
-
-    int min_x_index =
-        static_cast<int>(std::floor((node_min_x - min_x_) / resolution_));
-    int max_x_index =
-        static_cast<int>(std::ceil((node_max_x - min_x_) / resolution_));
-    int min_y_index =
-        static_cast<int>(std::floor((node_min_y - min_y_) / resolution_));
-    int max_y_index =
-        static_cast<int>(std::ceil((node_max_y - min_y_) / resolution_));
-    int min_z_index =
-        static_cast<int>(std::floor((node_min_z - min_z_) / resolution_));
-    int max_z_index =
-        static_cast<int>(std::ceil((node_max_z - min_z_) / resolution_));
-
-    min_x_index = std::clamp(min_x_index, 0, num_x_grid - 1);
-    max_x_index = std::clamp(max_x_index, 0, num_x_grid - 1);
-    min_y_index = std::clamp(min_y_index, 0, num_y_grid - 1);
-    max_y_index = std::clamp(max_y_index, 0, num_y_grid - 1);
-    min_z_index = std::clamp(min_z_index, 0, num_z_grid - 1);
-    max_z_index = std::clamp(max_z_index, 0, num_z_grid - 1);
-
-    for (int i = min_x_index; i <= max_x_index; ++i) {
-      for (int j = min_y_index; j <= max_y_index; ++j) {
-        for (int k = min_z_index; k <= max_z_index; ++k) {
-          grid_map_[i][j][k] = grid_state;
-        }
-      }
+void GridAstar::UpdateFromChangedKeys(octomap::OcTree *ocmap,
+                                      const octomap::point3d &bbx_min,
+                                      const octomap::point3d &bbx_max) {
+  if (ocmap == nullptr)
+    return;
+  if (!ocmap->isChangeDetectionEnabled()) {
+    // Changes before enabling are unknown, fall back to a full update.
+    ocmap->enableChangeDetection(true);
+    UpdateFromMap(ocmap, bbx_min, bbx_max);
+    return;
+  }
+
+  std::vector<octomap::OcTreeKey> keys;
+  for (octomap::KeyBoolMap::const_iterator it = ocmap->changedKeysBegin(),
+                                           end = ocmap->changedKeysEnd();
+       it != end; ++it) {
+    keys.push_back(it->first);
+  }
+  ocmap->resetChangeDetection();
+  UpdateFromKeys(ocmap, keys, bbx_min, bbx_max);
+}
+
+void GridAstar::UpdateFromKeys(const octomap::OcTree *ocmap,
+                               const std::vector<octomap::OcTreeKey> &keys,
+                               const octomap::point3d &bbx_min,
+                               const octomap::point3d &bbx_max) {
+  if (ocmap == nullptr)
+    return;
+
+  const int num_x_grid = grid_map_.size();
+  const float leaf_size = ocmap->getResolution();
+  int changed_min[3] = {num_x_grid, std::numeric_limits<int>::max(),
+                        std::numeric_limits<int>::max()};
+  int changed_max[3] = {-1, -1, -1};
+  for (const octomap::OcTreeKey &key : keys) {
+    const octomap::point3d center = ocmap->keyToCoord(key);
+    if (center.x() < bbx_min.x() || center.x() > bbx_max.x() ||
+        center.y() < bbx_min.y() || center.y() > bbx_max.y() ||
+        center.z() < bbx_min.z() || center.z() > bbx_max.z()) {
+      continue;
     }
+    // The changed key may belong to a pruned leaf, search returns the leaf.
+    const octomap::OcTreeNode *node = ocmap->search(key);
+    if (node == nullptr) {
+      continue;
+    }
+    RasterizeLeaf(center, leaf_size, node->getOccupancy(), 0, num_x_grid - 1,
+                  changed_min, changed_max);
   }
+  MarkDirtyX(changed_min[0], changed_max[0]);
+  MarkJumpTableDirty(changed_min, changed_max);
 }
 
 void GridAstar::MergeMap() {
   const int num_x_grid = grid_map_.size();
   const int num_y_grid = grid_map_[0].size();
   const int num_z_grid = grid_map_[0][0].size();
-  merge_map_.resize(num_x_grid,
-                    std::vector<std::vector<RangeVoxel>>(num_y_grid));
+  // Only rebuild the dirty slices once the map has been merged.
+  int update_x_min = 0;
+  int update_x_max = num_x_grid - 1;
+  if (merge_map_.size() != num_x_grid) {
+    merge_map_.resize(num_x_grid,
+                      std::vector<std::vector<RangeVoxel>>(num_y_grid));
+  } else if (!GetDirtyXRange(&update_x_min, &update_x_max)) {
+    return;
+  }
   int total_num = 0;
-  for (int i = 0; i < num_x_grid; ++i) {
+  // Columns are independent, each thread only writes its own slices.
+#pragma omp parallel for reduction(+ : total_num)
+  for (int i = update_x_min; i <= update_x_max; ++i) {
     for (int j = 0; j < num_y_grid; ++j) {
       int min = 0;
       int max = num_z_grid - 1;
@@ -243,11 +667,12 @@ void GridAstar::MergeMap() {
       }
     }
   }
-  std::cout << "Voxel1D total voxel num: " << total_num << std::endl;
+  std::cout << "Voxel1D total voxel num: " << total_num << " in x: ["
+            << update_x_min << ", " << update_x_max << "]" << std::endl;
 }
 
 std::vector<Block2D> GridAstar::Merge2DVoxelAlongY(
-    const std::vector<std::vector<RangeVoxel>> &yz_voxels) {
+    const std::vector<std::vector<RangeVoxel>> &yz_voxels) const {
   const int num_y_voxels = yz_voxels.size();
   std::set<Block2DWrapper> unmerged_voxels;
   std::vector<Block2D> merge_results;
@@ -340,9 +765,16 @@ void GridAstar::MergeMap2D() {
                                     : lhs.z_min_ < rhs.z_min_;
   };
   const int num_x_voxel = merge_map_.size();
-  merge_map_2d_.resize(num_x_voxel);
+  int update_x_min = 0;
+  int update_x_max = num_x_voxel - 1;
+  if (merge_map_2d_.size() != num_x_voxel) {
+    merge_map_2d_.resize(num_x_voxel);
+  } else if (!GetDirtyXRange(&update_x_min, &update_x_max)) {
+    return;
+  }
   int total_num = 0;
-  for (int i = 0; i < num_x_voxel; ++i) {
+#pragma omp parallel for schedule(dynamic) reduction(+ : total_num)
+  for (int i = update_x_min; i <= update_x_max; ++i) {
     merge_map_2d_[i] = Merge2DVoxelAlongY(merge_map_[i]);
     std::sort(merge_map_2d_[i].begin(), merge_map_2d_[i].end(), cmp);
     total_num += merge_map_2d_[i].size();
@@ -350,97 +782,293 @@ void GridAstar::MergeMap2D() {
   std::cout << "total_num: " << total_num << std::endl;
 }
 
-std::vector<Block3D> GridAstar::Merge3DVoxelAlongX(
-    const std::vector<std::vector<Block2D>> &xyz_voxels) {
-  const int num_x_voxels = xyz_voxels.size();
-  int block_id = 0;
-  GraphTable graph_table;
-  std::vector<Block3D> merge_results;
-  merge_results.reserve(kMapXYZSize);
-  std::set<Block3DWrapper> unmerged_voxels;
-  for (int i = 0; i < num_x_voxels; ++i) {
-    std::set<Block3DWrapper> merged_voxels;
-    const int num_yz_voxels = xyz_voxels[i].size();
-    for (int j = 0; j < num_yz_voxels; ++j) {
-      const Block2D new_yz_voxel = xyz_voxels[i][j];
-      // Find the range to merge in unmerged_voxels.
-      const int voxel_y_min_lb = new_yz_voxel.y_min_ - kMergeBuffer + 1;
-      const int voxel_y_min_ub = new_yz_voxel.y_min_ + kMergeBuffer - 1;
-      const int voxel_z_min_lb = new_yz_voxel.z_min_ - kMergeBuffer + 1;
-      const int voxel_z_min_ub = new_yz_voxel.z_min_ + kMergeBuffer - 1;
-      const int voxel_y_max_lb = new_yz_voxel.y_max_ - kMergeBuffer + 1;
-      const int voxel_y_max_ub = new_yz_voxel.y_max_ + kMergeBuffer - 1;
-      const int voxel_z_max_lb = new_yz_voxel.z_max_ - kMergeBuffer + 1;
-      const int voxel_z_max_ub = new_yz_voxel.z_max_ + kMergeBuffer - 1;
-
-      bool is_merged = false;
-      bool is_connected = false;
-      for (auto it = unmerged_voxels.begin(); it != unmerged_voxels.end();) {
-        const int plug_y_min = it->plug_.y_min_;
-        const int plug_z_min = it->plug_.z_min_;
-        const int plug_y_max = it->plug_.y_max_;
-        const int plug_z_max = it->plug_.z_max_;
-        // Two voxels can be merged if their bounding boxes are similar.
-        if (voxel_y_min_lb <= plug_y_min && plug_y_min <= voxel_y_min_ub &&
-            voxel_z_min_lb <= plug_z_min && plug_z_min <= voxel_z_min_ub &&
-            voxel_y_max_lb <= plug_y_max && plug_y_max <= voxel_y_max_ub &&
-            voxel_z_max_lb <= plug_z_max && plug_z_max <= voxel_z_max_ub) {
-          // Merge and add to the result.
-          Block3DWrapper new_voxel_wrapper = *it;
-          new_voxel_wrapper.plug_ = new_yz_voxel;
-          new_voxel_wrapper.block_3d_.EmplaceBlockBack(new_yz_voxel);
-          merged_voxels.insert(new_voxel_wrapper);
-          // Erase the range.
-          unmerged_voxels.erase(it++);
-          is_merged = true;
+void GridAstar::LinkBlock2D(const std::vector<Block2D> &last_yz_voxels,
+                            const std::vector<Block2D> &yz_voxels,
+                            std::vector<int> *links,
+                            std::vector<BlockConnection> *connections) const {
+  // Both slices are sorted by (y_min, z_min), see MergeMap2D.
+  const int num_last_voxels = last_yz_voxels.size();
+  const int num_yz_voxels = yz_voxels.size();
+  links->assign(num_yz_voxels, -1);
+  connections->clear();
+  std::vector<char> is_linked(num_last_voxels, 0);
+  for (int j = 0; j < num_yz_voxels; ++j) {
+    const Block2D &new_yz_voxel = yz_voxels[j];
+    // Find the range to merge in last_yz_voxels.
+    const int voxel_y_min_lb = new_yz_voxel.y_min_ - kMergeBuffer + 1;
+    const int voxel_y_min_ub = new_yz_voxel.y_min_ + kMergeBuffer - 1;
+    const int voxel_z_min_lb = new_yz_voxel.z_min_ - kMergeBuffer + 1;
+    const int voxel_z_min_ub = new_yz_voxel.z_min_ + kMergeBuffer - 1;
+    const int voxel_y_max_lb = new_yz_voxel.y_max_ - kMergeBuffer + 1;
+    const int voxel_y_max_ub = new_yz_voxel.y_max_ + kMergeBuffer - 1;
+    const int voxel_z_max_lb = new_yz_voxel.z_max_ - kMergeBuffer + 1;
+    const int voxel_z_max_ub = new_yz_voxel.z_max_ + kMergeBuffer - 1;
+
+    for (int p = 0; p < num_last_voxels; ++p) {
+      // Each Block3D can only be continued once.
+      if (is_linked[p]) {
+        continue;
+      }
+      const Block2D &plug = last_yz_voxels[p];
+      const int plug_y_min = plug.y_min_;
+      const int plug_z_min = plug.z_min_;
+      const int plug_y_max = plug.y_max_;
+      const int plug_z_max = plug.z_max_;
+      // Two voxels can be merged if their bounding boxes are similar.
+      if (voxel_y_min_lb <= plug_y_min && plug_y_min <= voxel_y_min_ub &&
+          voxel_z_min_lb <= plug_z_min && plug_z_min <= voxel_z_min_ub &&
+          voxel_y_max_lb <= plug_y_max && plug_y_max <= voxel_y_max_ub &&
+          voxel_z_max_lb <= plug_z_max && plug_z_max <= voxel_z_max_ub) {
+        (*links)[j] = p;
+        is_linked[p] = 1;
+        break;
+      }
+      // If two voxels can not be merged, which means they belong to different
+      // blocks, check if they are connected.
+      const std::vector<Block2D> overlap_blocks = new_yz_voxel.GetOverlap(plug);
+      for (const Block2D &overlap_block : overlap_blocks) {
+        const int overlap_y_min = overlap_block.y_min_;
+        const int overlap_z_min = overlap_block.z_min_;
+        const int overlap_y_max = overlap_block.y_max_;
+        const int overlap_z_max = overlap_block.z_max_;
+        if (overlap_y_max - overlap_y_min + 1 >= kConnectivityMinY &&
+            overlap_z_max - overlap_z_min + 1 >= kConnectivityMinZ) {
+          connections->emplace_back(p, j, overlap_block);
           break;
         }
-        // If two voxels can not be merged, which means they belong to different
-        // blocks, check if they are connected.
-        const std::vector<Block2D> overlap_blocks =
-            new_yz_voxel.GetOverlap(it->plug_);
-        for (const Block2D &overlap_block : overlap_blocks) {
-          const int overlap_y_min = overlap_block.y_min_;
-          const int overlap_z_min = overlap_block.z_min_;
-          const int overlap_y_max = overlap_block.y_max_;
-          const int overlap_z_max = overlap_block.z_max_;
-          if (overlap_y_max - overlap_y_min + 1 >= kConnectivityMinY &&
-              overlap_z_max - overlap_z_min + 1 >= kConnectivityMinZ) {
-            // If two voxels are partially overlapped, add a new edge to the
-            // graph.
-            const int key_block_x = i;
-            const KeyBlock last_key_block(
-                key_block_x - 1, it->block_3d_.block_id_, overlap_block);
-            const KeyBlock key_block(key_block_x, block_id, overlap_block);
-            graph_table.AddNewEdge(last_key_block, key_block);
-            break;
-          }
-        }
-        it++;
       }
-      if (!is_merged) {
-        const Block3D new_voxel(i, new_yz_voxel);
-        const Block3DWrapper new_voxel_wrapper(new_voxel, new_yz_voxel,
-                                               block_id);
-        // Update block id of next voxel.
-        ++block_id;
-        merged_voxels.insert(new_voxel_wrapper);
+    }
+  }
+}
+
+void GridAstar::UpdateBlock3D(
+    const std::vector<std::vector<Block2D>> &xyz_voxels, const int x_min,
+    const int x_max) {
+  const int num_x_voxels = xyz_voxels.size();
+  if (num_x_voxels == 0 || x_min > x_max) {
+    return;
+  }
+  // Block3D containing the dirty slices need to be rebuilt.
+  std::unordered_set<int> affected_ids;
+  for (int x = x_min; x <= x_max; ++x) {
+    affected_ids.insert(block_2d_ids_[x].begin(), block_2d_ids_[x].end());
+  }
+  // IDs still used by the untouched slices on the left.
+  std::unordered_set<int> left_ids;
+  if (x_min > 0) {
+    left_ids.insert(block_2d_ids_[x_min - 1].begin(),
+                    block_2d_ids_[x_min - 1].end());
+  }
+  // Re-link the dirty slices and the slice next to them.
+  const int link_x_max = std::min(x_max + 1, num_x_voxels - 1);
+#pragma omp parallel for schedule(dynamic)
+  for (int x = x_min; x <= link_x_max; ++x) {
+    if (x == 0) {
+      block_2d_links_[x].assign(xyz_voxels[x].size(), -1);
+      block_connections_[x].clear();
+    } else {
+      LinkBlock2D(xyz_voxels[x - 1], xyz_voxels[x], &block_2d_links_[x],
+                  &block_connections_[x]);
+    }
+  }
+  // Propagate block ids along the links until they are the same as before.
+  int changed_x_max = x_max;
+  for (int x = x_min; x < num_x_voxels; ++x) {
+    const bool is_dirty = x <= x_max;
+    std::vector<int> &ids = block_2d_ids_[x];
+    if (is_dirty) {
+      ids.assign(xyz_voxels[x].size(), -1);
+    }
+    bool is_changed = is_dirty;
+    const int num_yz_voxels = ids.size();
+    for (int j = 0; j < num_yz_voxels; ++j) {
+      const int link = block_2d_links_[x][j];
+      int id = ids[j];
+      if (link >= 0) {
+        id = block_2d_ids_[x - 1][link];
+      } else if (is_dirty ||
+                 (x == x_max + 1 && left_ids.find(id) != left_ids.end())) {
+        // New Block3D, or the Block3D is split from the left region.
+        id = next_block_id_++;
+      }
+      if (id != ids[j]) {
+        if (ids[j] >= 0) {
+          affected_ids.insert(ids[j]);
+        }
+        affected_ids.insert(id);
+        ids[j] = id;
+        is_changed = true;
       }
     }
-    // Add all item of unmerged_voxels to result.
-    for (auto &item : unmerged_voxels) {
-      merge_results.emplace_back(item.block_3d_);
+    if (!is_changed) {
+      break;
     }
-    unmerged_voxels = merged_voxels;
+    changed_x_max = x;
   }
-  // Add all item of unmerged_voxels to result.
-  for (auto &item : unmerged_voxels) {
-    merge_results.emplace_back(item.block_3d_);
+  for (int x = x_min; x <= changed_x_max; ++x) {
+    block_index_.UpdateSlice(x, xyz_voxels[x], block_2d_ids_[x]);
+  }
+  // Remove the affected Block3D and rebuild them from the Block2D chains.
+  int scan_x_min = x_min;
+  int scan_x_max = changed_x_max;
+  auto remove_it =
+      std::remove_if(merge_map_3d_.begin(), merge_map_3d_.end(),
+                     [&](const Block3D &block) {
+                       if (affected_ids.find(block.block_id_) ==
+                           affected_ids.end()) {
+                         return false;
+                       }
+                       scan_x_min = std::min(scan_x_min, block.x_min_);
+                       scan_x_max = std::max(scan_x_max, block.x_max_);
+                       return true;
+                     });
+  merge_map_3d_.erase(remove_it, merge_map_3d_.end());
+  std::unordered_map<int, int> block_index;
+  for (int x = scan_x_min; x <= scan_x_max; ++x) {
+    const int num_yz_voxels = xyz_voxels[x].size();
+    for (int j = 0; j < num_yz_voxels; ++j) {
+      const int id = block_2d_ids_[x][j];
+      if (affected_ids.find(id) == affected_ids.end()) {
+        continue;
+      }
+      auto index_it = block_index.find(id);
+      if (index_it == block_index.end()) {
+        block_index[id] = merge_map_3d_.size();
+        merge_map_3d_.emplace_back(x, xyz_voxels[x][j]);
+        merge_map_3d_.back().block_id_ = id;
+      } else {
+        merge_map_3d_[index_it->second].EmplaceBlockBack(xyz_voxels[x][j]);
+      }
+    }
+  }
+  // The connections of a slice hold the ids of the slice before it.
+  UpdateGraphTable(x_min, std::min(changed_x_max + 1, num_x_voxels - 1));
+}
+
+void GridAstar::UpdateGraphTable(const int x_min, const int x_max) {
+  const int num_x_voxels = block_connections_.size();
+  for (int x = std::max(x_min, 1); x <= x_max; ++x) {
+    for (const BlockConnection &connection : block_connections_[x]) {
+      const KeyBlock last_key_block(
+          x - 1, block_2d_ids_[x - 1][connection.last_index_],
+          connection.overlap_);
+      const KeyBlock key_block(x, block_2d_ids_[x][connection.index_],
+                               connection.overlap_);
+      graph_table_.AddNewEdge(last_key_block, key_block);
+    }
   }
   // Update topology of the graph.
-  graph_table.UpdateEdgesInSameBlock();
-  graph_table_ = graph_table;
-  return merge_results;
+  if (x_min <= 1 && x_max >= num_x_voxels - 1) {
+    graph_table_.Build();
+  } else {
+    graph_table_.Patch(x_min, x_max);
+  }
+}
+
+void GridAstar::LabelBlock2D() {
+  const int num_x_voxels = block_2d_links_.size();
+  if (num_x_voxels == 0) {
+    next_block_id_ = 0;
+    return;
+  }
+  const int num_chunks = std::min(omp_get_max_threads(), num_x_voxels);
+  const int chunk_size = (num_x_voxels + num_chunks - 1) / num_chunks;
+  // Label each chunk with local ids, every Block2D in the first slice of a
+  // chunk starts a partial Block3D.
+  std::vector<int> num_local_ids(num_chunks, 0);
+#pragma omp parallel for schedule(static, 1)
+  for (int c = 0; c < num_chunks; ++c) {
+    const int x_begin = c * chunk_size;
+    const int x_end = std::min(x_begin + chunk_size, num_x_voxels);
+    int local_id = 0;
+    for (int x = x_begin; x < x_end; ++x) {
+      const int num_yz_voxels = block_2d_links_[x].size();
+      block_2d_ids_[x].resize(num_yz_voxels);
+      for (int j = 0; j < num_yz_voxels; ++j) {
+        const int link = block_2d_links_[x][j];
+        block_2d_ids_[x][j] =
+            x != x_begin && link >= 0 ? block_2d_ids_[x - 1][link] : local_id++;
+      }
+    }
+    num_local_ids[c] = local_id;
+  }
+  // Stitch the partial Block3D at the first slice of each chunk.
+  std::vector<std::vector<int>> global_ids(num_chunks);
+  int offset = 0;
+  for (int c = 0; c < num_chunks; ++c) {
+    global_ids[c].resize(num_local_ids[c]);
+    for (int l = 0; l < num_local_ids[c]; ++l) {
+      global_ids[c][l] = offset + l;
+    }
+    offset += num_local_ids[c];
+    const int x_begin = c * chunk_size;
+    if (c == 0 || x_begin >= num_x_voxels) {
+      continue;
+    }
+    const int num_yz_voxels = block_2d_links_[x_begin].size();
+    for (int j = 0; j < num_yz_voxels; ++j) {
+      const int link = block_2d_links_[x_begin][j];
+      if (link >= 0) {
+        global_ids[c][block_2d_ids_[x_begin][j]] =
+            global_ids[c - 1][block_2d_ids_[x_begin - 1][link]];
+      }
+    }
+  }
+  next_block_id_ = offset;
+#pragma omp parallel for schedule(static, 1)
+  for (int c = 0; c < num_chunks; ++c) {
+    const int x_begin = c * chunk_size;
+    const int x_end = std::min(x_begin + chunk_size, num_x_voxels);
+    for (int x = x_begin; x < x_end; ++x) {
+      for (int &id : block_2d_ids_[x]) {
+        id = global_ids[c][id];
+      }
+    }
+  }
+}
+
+std::vector<Block3D> GridAstar::Merge3DVoxelAlongX(
+    const std::vector<std::vector<Block2D>> &xyz_voxels) {
+  const int num_x_voxels = xyz_voxels.size();
+  block_2d_links_.assign(num_x_voxels, std::vector<int>());
+  block_2d_ids_.assign(num_x_voxels, std::vector<int>());
+  block_connections_.assign(num_x_voxels, std::vector<BlockConnection>());
+  // Links only depend on two adjacent slices.
+#pragma omp parallel for schedule(dynamic)
+  for (int x = 0; x < num_x_voxels; ++x) {
+    if (x == 0) {
+      block_2d_links_[x].assign(xyz_voxels[x].size(), -1);
+    } else {
+      LinkBlock2D(xyz_voxels[x - 1], xyz_voxels[x], &block_2d_links_[x],
+                  &block_connections_[x]);
+    }
+  }
+  LabelBlock2D();
+  const int num_y_voxels = grid_map_.empty() ? 0 : grid_map_[0].size();
+  block_index_.Resize(num_x_voxels, num_y_voxels);
+#pragma omp parallel for
+  for (int x = 0; x < num_x_voxels; ++x) {
+    block_index_.UpdateSlice(x, xyz_voxels[x], block_2d_ids_[x]);
+  }
+  // Assemble Block3D along the chains of Block2D.
+  merge_map_3d_.clear();
+  merge_map_3d_.reserve(kMapXYZSize);
+  std::vector<int> block_index(next_block_id_, -1);
+  for (int x = 0; x < num_x_voxels; ++x) {
+    const int num_yz_voxels = xyz_voxels[x].size();
+    for (int j = 0; j < num_yz_voxels; ++j) {
+      const int id = block_2d_ids_[x][j];
+      if (block_index[id] < 0) {
+        block_index[id] = merge_map_3d_.size();
+        merge_map_3d_.emplace_back(x, xyz_voxels[x][j]);
+        merge_map_3d_.back().block_id_ = id;
+      } else {
+        merge_map_3d_[block_index[id]].EmplaceBlockBack(xyz_voxels[x][j]);
+      }
+    }
+  }
+  UpdateGraphTable(0, num_x_voxels - 1);
+  return merge_map_3d_;
 }
 
 void GridAstar::Merge3DVoxelAlongXUnitTest() {
@@ -465,7 +1093,14 @@ void GridAstar::Merge3DVoxelAlongXUnitTest() {
 }
 
 void GridAstar::MergeMap3D() {
-  merge_map_3d_ = Merge3DVoxelAlongX(merge_map_2d_);
+  int update_x_min = 0;
+  int update_x_max = 0;
+  if (block_2d_ids_.size() != merge_map_2d_.size()) {
+    Merge3DVoxelAlongX(merge_map_2d_);
+  } else if (GetDirtyXRange(&update_x_min, &update_x_max)) {
+    UpdateBlock3D(merge_map_2d_, update_x_min, update_x_max);
+  }
+  ClearDirtyX();
   std::cout << "total_num: " << merge_map_3d_.size() << std::endl;
 }
 
@@ -627,8 +1262,49 @@ GridAstarOutput GridAstar::AstarPathDistance(const Eigen::Vector3f &start_p,
   }
 }
 
+GridAstarOutput GridAstar::JpsPathDistance(const Eigen::Vector3f &start_p,
+                                           const Eigen::Vector3f &end_p) {
+  GridAstarOutput output;
+  output.success = false;
+  output.path_length = 0.0;
+  // The graph search does not count expansions.
+  output.num_expansions = 0;
+  const int num_x_grid = grid_map_.size();
+  if (num_x_grid == 0) {
+    return output;
+  }
+  const int num_y_grid = grid_map_[0].size();
+  const int num_z_grid = grid_map_[0][0].size();
+  // The map util reads jps_map_ directly, nothing is copied.
+  std::shared_ptr<JPS::VoxelMapUtil> map_util =
+      std::make_shared<JPS::VoxelMapUtil>();
+  map_util->setMapView(Vec3f(min_x_, min_y_, min_z_),
+                       Vec3i(num_x_grid, num_y_grid, num_z_grid),
+                       jps_map_.data(), resolution_);
+  JPSPlanner3D planner(false);
+  planner.setMapUtil(map_util);
+  planner.updateMapView();
+  if (jump_table_ != nullptr) {
+    UpdateJumpTable();
+    planner.setJumpTable(jump_table_);
+  }
+  output.success = planner.plan(start_p.cast<decimal_t>(),
+                                end_p.cast<decimal_t>(), 1.0, true);
+  if (output.success) {
+    const vec_Vecf<3> path = planner.getRawPath();
+    const int num_waypoints = path.size();
+    for (int i = 1; i < num_waypoints; ++i) {
+      output.path_length += (path[i] - path[i - 1]).norm();
+    }
+  } else {
+    output.path_length = (end_p - start_p).norm();
+  }
+  return output;
+}
+
 float GridAstar::BlockPathDistance(const Eigen::Vector3f &start_p,
-                                   const Eigen::Vector3f &end_p) {
+                                   const Eigen::Vector3f &end_p,
+                                   const bool use_heuristic) {
   block_path_.clear();
   int index_start_x =
       static_cast<int>(std::floor((start_p.x() - min_x_) / resolution_));
@@ -642,131 +1318,375 @@ float GridAstar::BlockPathDistance(const Eigen::Vector3f &start_p,
       static_cast<int>(std::floor((end_p.y() - min_y_) / resolution_));
   int index_end_z =
       static_cast<int>(std::floor((end_p.z() - min_z_) / resolution_));
-  // Find the block that contains the start point.
-  int num_blocks = merge_map_3d_.size();
-  bool is_start_locked = false;
-  bool is_end_locked = false;
-  int start_block_index = -1;
-  int end_block_index = -1;
-  for (int i = 0; i < num_blocks; ++i) {
-    if (is_start_locked && is_end_locked) {
+  // Find the blocks that contain the start point and the end point.
+  const int start_block_index =
+      block_index_.GetBlockId(index_start_x, index_start_y, index_start_z);
+  const int end_block_index =
+      block_index_.GetBlockId(index_end_x, index_end_y, index_end_z);
+  if (start_block_index == end_block_index) {
+    // TODO: Calculate the distance between two points in the same block.
+    return (end_p - start_p).norm();
+  }
+  // A* algorithm to find the path between two blocks. Edge weights are the
+  // distances between the centers of key blocks, so the distance from the
+  // center to the end point is a consistent heuristic. It is also the exact
+  // cost from a key block of the end block to the end point.
+  const int nums_node = graph_table_.nodes_.size();
+  std::vector<int> father_nodes(nums_node, -1);
+  int end_father = -1;
+  std::vector<char> is_visited(nums_node, 0);
+  std::vector<float> distance(nums_node, 0.0);
+  float end_distance = 0.0;
+  // Pair of node index and f score.
+  std::priority_queue<std::pair<int, float>,
+                      std::vector<std::pair<int, float>>, DijkstraNodeCmp>
+      astar_q;
+  auto heur_score = [&](const KeyBlock &key_block) -> float {
+    return use_heuristic
+               ? key_block.GetDistance(index_end_x, index_end_y, index_end_z)
+               : 0.0f;
+  };
+  // Add the key block of start block to the queue.
+  int start_node_begin = 0;
+  int start_node_end = 0;
+  graph_table_.GetBlockNodes(start_block_index, &start_node_begin,
+                             &start_node_end);
+  for (int i = start_node_begin; i < start_node_end; ++i) {
+    const KeyBlock &key_block = graph_table_.nodes_[i].key_block_;
+    // Compute the rough distance between the start point and the key block.
+    const float edge_weight =
+        key_block.GetDistance(index_start_x, index_start_y, index_start_z);
+    astar_q.emplace(i, edge_weight + heur_score(key_block));
+    is_visited[i] = 1;
+    father_nodes[i] = -1;
+    distance[i] = edge_weight;
+  }
+  bool is_path_found = false;
+  int count = 0;
+  while (!astar_q.empty()) {
+    // Select the node with the smallest f score.
+    const std::pair<int, float> cur_node = astar_q.top();
+    astar_q.pop();
+    // Every path through the remaining nodes is longer than the found one.
+    if (is_path_found && cur_node.second >= end_distance) {
       break;
     }
-    if (!is_start_locked && merge_map_3d_[i].IsInBlock(
-                                index_start_x, index_start_y, index_start_z)) {
-      start_block_index = merge_map_3d_[i].block_id_;
-      is_start_locked = true;
+    // Skip nodes that is in Closed state.
+    if (is_visited[cur_node.first] == 2) {
+      continue;
     }
-    if (!is_end_locked &&
-        merge_map_3d_[i].IsInBlock(index_end_x, index_end_y, index_end_z)) {
-      end_block_index = merge_map_3d_[i].block_id_;
-      is_end_locked = true;
+    // Set the node to Closed state.
+    is_visited[cur_node.first] = 2;
+    ++count;
+    const float cur_distance = distance[cur_node.first];
+    const GraphNode &graph_node = graph_table_.nodes_[cur_node.first];
+    // Check if the node is in the end block.
+    if (graph_node.key_block_.block_id_ == end_block_index) {
+      const float edge_weight =
+          graph_node.key_block_.GetDistance(index_end_x, index_end_y,
+                                            index_end_z) +
+          cur_distance;
+      if (!is_path_found || edge_weight < end_distance) {
+        end_father = cur_node.first;
+        is_path_found = true;
+        end_distance = edge_weight;
+      }
     }
+    // Expand the node.
+    graph_table_.ForEachEdge(cur_node.first, [&](const int neighbor_index,
+                                                 const float weight) {
+      if (is_visited[neighbor_index] == 2) {
+        return;
+      }
+      const float edge_weight = weight + cur_distance;
+      if (is_visited[neighbor_index] == 0 ||
+          edge_weight < distance[neighbor_index]) {
+        father_nodes[neighbor_index] = cur_node.first;
+        is_visited[neighbor_index] = 1;
+        distance[neighbor_index] = edge_weight;
+        astar_q.emplace(
+            neighbor_index,
+            edge_weight +
+                heur_score(graph_table_.nodes_[neighbor_index].key_block_));
+      }
+    });
+  }
+  if (is_path_found) {
+    std::vector<int> path_blocks;
+    int cur_node_index = end_father;
+    while (cur_node_index != -1) {
+      path_blocks.emplace_back(cur_node_index);
+      cur_node_index = father_nodes[cur_node_index];
+    }
+    std::cout << "[Block Astar] waypoint generated!! waypoint num: "
+              << path_blocks.size() << ", select node num: " << count
+              << std::endl;
+    std::reverse(path_blocks.begin(), path_blocks.end());
+    block_path_ = path_blocks;
+    return end_distance;
+  } else {
+    std::cout << "[WARNING] no path !! from " << std::endl
+              << start_p << std::endl
+              << "to " << std::endl
+              << end_p << std::endl;
+    return (end_p - start_p).norm();
   }
+}
+
+float GridAstar::BidirectionalBlockPathDistance(const Eigen::Vector3f &start_p,
+                                                const Eigen::Vector3f &end_p) {
+  block_path_.clear();
+  int index_start_x =
+      static_cast<int>(std::floor((start_p.x() - min_x_) / resolution_));
+  int index_start_y =
+      static_cast<int>(std::floor((start_p.y() - min_y_) / resolution_));
+  int index_start_z =
+      static_cast<int>(std::floor((start_p.z() - min_z_) / resolution_));
+  int index_end_x =
+      static_cast<int>(std::floor((end_p.x() - min_x_) / resolution_));
+  int index_end_y =
+      static_cast<int>(std::floor((end_p.y() - min_y_) / resolution_));
+  int index_end_z =
+      static_cast<int>(std::floor((end_p.z() - min_z_) / resolution_));
+  const int start_block_index =
+      block_index_.GetBlockId(index_start_x, index_start_y, index_start_z);
+  const int end_block_index =
+      block_index_.GetBlockId(index_end_x, index_end_y, index_end_z);
   if (start_block_index == end_block_index) {
-    // TODO: Calculate the distance between two points in the same block.
     return (end_p - start_p).norm();
-  } else {
-    // Dijkstra algorithm to find the path between two blocks.
-    const int nums_node = graph_table_.nodes_.size();
-    std::vector<int> father_nodes(nums_node, -1);
-    int end_father = -1;
-    std::vector<int> is_visited(nums_node, 0);
-    int is_end_visited = 0;
-    std::vector<float> distance(nums_node, 0.0);
-    float end_distance = 0.0;
-    std::priority_queue<std::pair<int, float>,
-                        std::vector<std::pair<int, float>>, DijkstraNodeCmp>
-        dijkstra_q;
-    // Add the key block of start block to the queue.
-    for (int i = 0; i < nums_node; ++i) {
-      const KeyBlock key_block = graph_table_.nodes_[i].key_block_;
-      if (key_block.block_id_ == start_block_index) {
-        // Compute the rough distance between the start point and the key block.
-        const float delta_x = index_start_x - key_block.x_;
-        const float delta_y = index_start_y - 0.5 * (key_block.block_.y_min_ +
-                                                     key_block.block_.y_max_);
-        const float delta_z = index_start_z - 0.5 * (key_block.block_.z_min_ +
-                                                     key_block.block_.z_max_);
-        const float edge_weight = std::hypot(delta_x, delta_y, delta_z);
-        dijkstra_q.emplace(i, edge_weight);
-        is_visited[i] = 1;
-        father_nodes[i] = -1;
-        distance[i] = edge_weight;
-      }
+  }
+  // Forward search from the start point and backward search from the end
+  // point. Both use the average of the two heuristics as potential, which
+  // keeps them consistent with each other, so the search can stop once the
+  // sum of the two smallest keys reaches the best path found.
+  const int nums_node = graph_table_.nodes_.size();
+  std::vector<int> father_nodes[2] = {std::vector<int>(nums_node, -1),
+                                      std::vector<int>(nums_node, -1)};
+  std::vector<char> is_visited[2] = {std::vector<char>(nums_node, 0),
+                                     std::vector<char>(nums_node, 0)};
+  std::vector<float> distance[2] = {std::vector<float>(nums_node, 0.0),
+                                    std::vector<float>(nums_node, 0.0)};
+  std::priority_queue<std::pair<int, float>,
+                      std::vector<std::pair<int, float>>, DijkstraNodeCmp>
+      astar_q[2];
+  auto potential = [&](const int node_index, const int dir) -> float {
+    const KeyBlock &key_block = graph_table_.nodes_[node_index].key_block_;
+    const float forward_potential =
+        0.5 * (key_block.GetDistance(index_end_x, index_end_y, index_end_z) -
+               key_block.GetDistance(index_start_x, index_start_y,
+                                     index_start_z));
+    return dir == 0 ? forward_potential : -forward_potential;
+  };
+  const int block_indexes[2] = {start_block_index, end_block_index};
+  const int seed_x[2] = {index_start_x, index_end_x};
+  const int seed_y[2] = {index_start_y, index_end_y};
+  const int seed_z[2] = {index_start_z, index_end_z};
+  for (int dir = 0; dir < 2; ++dir) {
+    int seed_node_begin = 0;
+    int seed_node_end = 0;
+    graph_table_.GetBlockNodes(block_indexes[dir], &seed_node_begin,
+                               &seed_node_end);
+    for (int i = seed_node_begin; i < seed_node_end; ++i) {
+      const float edge_weight = graph_table_.nodes_[i].key_block_.GetDistance(
+          seed_x[dir], seed_y[dir], seed_z[dir]);
+      astar_q[dir].emplace(i, edge_weight + potential(i, dir));
+      is_visited[dir][i] = 1;
+      distance[dir][i] = edge_weight;
     }
-    bool is_path_found = false;
-    while (!dijkstra_q.empty()) {
-      // Select the node with the smallest distance.
-      std::pair<int, float> cur_node = dijkstra_q.top();
-      dijkstra_q.pop();
-      // Check if the node is the end block.
-      if (cur_node.first == -1) {
-        is_path_found = true;
-        break;
-      }
-      // Skip nodes that is in Closed state.
-      if (is_visited[cur_node.first] == 2) {
-        continue;
+  }
+  float best_distance = std::numeric_limits<float>::max();
+  int meet_node = -1;
+  int count = 0;
+  while (!astar_q[0].empty() && !astar_q[1].empty()) {
+    // Remove nodes that is in Closed state from the top of queues.
+    if (is_visited[0][astar_q[0].top().first] == 2) {
+      astar_q[0].pop();
+      continue;
+    }
+    if (is_visited[1][astar_q[1].top().first] == 2) {
+      astar_q[1].pop();
+      continue;
+    }
+    const float forward_key = astar_q[0].top().second;
+    const float backward_key = astar_q[1].top().second;
+    if (forward_key + backward_key >= best_distance) {
+      break;
+    }
+    const int dir = forward_key <= backward_key ? 0 : 1;
+    const int cur_index = astar_q[dir].top().first;
+    astar_q[dir].pop();
+    is_visited[dir][cur_index] = 2;
+    ++count;
+    const float cur_distance = distance[dir][cur_index];
+    graph_table_.ForEachEdge(cur_index, [&](const int neighbor_index,
+                                            const float weight) {
+      if (is_visited[dir][neighbor_index] == 2) {
+        return;
       }
-      // Set the node to Closed state.
-      is_visited[cur_node.first] = 2;
-      const GraphNode graph_node = graph_table_.nodes_[cur_node.first];
-      // Check if the node is in the end block.
-      if (graph_node.key_block_.block_id_ == end_block_index) {
-        const float delta_x = index_end_x - graph_node.key_block_.x_;
-        const float delta_y =
-            index_end_y - 0.5 * (graph_node.key_block_.block_.y_min_ +
-                                 graph_node.key_block_.block_.y_max_);
-        const float delta_z =
-            index_end_z - 0.5 * (graph_node.key_block_.block_.z_min_ +
-                                 graph_node.key_block_.block_.z_max_);
-        const float edge_weight =
-            std::hypot(delta_x, delta_y, delta_z) + cur_node.second;
-        if (is_end_visited == 0 ||
-            (is_end_visited == 1 && edge_weight < end_distance)) {
-          end_father = cur_node.first;
-          is_end_visited = 1;
-          end_distance = edge_weight;
-          dijkstra_q.emplace(-1, edge_weight);
+      const float edge_weight = weight + cur_distance;
+      if (is_visited[dir][neighbor_index] == 0 ||
+          edge_weight < distance[dir][neighbor_index]) {
+        father_nodes[dir][neighbor_index] = cur_index;
+        is_visited[dir][neighbor_index] = 1;
+        distance[dir][neighbor_index] = edge_weight;
+        astar_q[dir].emplace(neighbor_index,
+                             edge_weight + potential(neighbor_index, dir));
+        // Check if the two searches meet.
+        if (is_visited[1 - dir][neighbor_index] != 0 &&
+            edge_weight + distance[1 - dir][neighbor_index] < best_distance) {
+          best_distance = edge_weight + distance[1 - dir][neighbor_index];
+          meet_node = neighbor_index;
         }
       }
-      // Expand the node.
-      const int num_edges = graph_node.edges_.size();
-      for (int i = 0; i < num_edges; ++i) {
-        const int neighbor_index = graph_node.edges_[i].dest_id_;
-        const float edge_weight =
-            graph_node.edges_[i].weight_ + cur_node.second;
-        if (is_visited[neighbor_index] == 0 ||
-            (is_visited[neighbor_index] == 1 &&
-             edge_weight < distance[neighbor_index])) {
-          father_nodes[neighbor_index] = cur_node.first;
-          is_visited[neighbor_index] = 1;
-          distance[neighbor_index] = edge_weight;
-          dijkstra_q.emplace(neighbor_index, edge_weight);
+    });
+  }
+  if (meet_node != -1) {
+    std::vector<int> path_blocks;
+    for (int cur_node_index = meet_node; cur_node_index != -1;
+         cur_node_index = father_nodes[0][cur_node_index]) {
+      path_blocks.emplace_back(cur_node_index);
+    }
+    std::reverse(path_blocks.begin(), path_blocks.end());
+    for (int cur_node_index = father_nodes[1][meet_node]; cur_node_index != -1;
+         cur_node_index = father_nodes[1][cur_node_index]) {
+      path_blocks.emplace_back(cur_node_index);
+    }
+    std::cout << "[Bidirectional Block Astar] waypoint generated!! waypoint "
+                 "num: "
+              << path_blocks.size() << ", select node num: " << count
+              << std::endl;
+    block_path_ = path_blocks;
+    return best_distance;
+  } else {
+    std::cout << "[WARNING] no path !! from " << std::endl
+              << start_p << std::endl
+              << "to " << std::endl
+              << end_p << std::endl;
+    return (end_p - start_p).norm();
+  }
+}
+
+std::vector<float> GridAstar::BlockPathDistances(
+    const Eigen::Vector3f &start_p,
+    const std::vector<Eigen::Vector3f> &end_ps) const {
+  const int num_ends = end_ps.size();
+  std::vector<float> end_distances(num_ends, 0.0);
+  const int index_start_x =
+      static_cast<int>(std::floor((start_p.x() - min_x_) / resolution_));
+  const int index_start_y =
+      static_cast<int>(std::floor((start_p.y() - min_y_) / resolution_));
+  const int index_start_z =
+      static_cast<int>(std::floor((start_p.z() - min_z_) / resolution_));
+  const int start_block_index =
+      block_index_.GetBlockId(index_start_x, index_start_y, index_start_z);
+  // Group the end points by the block that contains them.
+  std::vector<Eigen::Vector3i> end_indexes(num_ends);
+  std::unordered_map<int, std::vector<int>> end_blocks;
+  std::vector<char> is_end_found(num_ends, 0);
+  int num_pending = 0;
+  for (int i = 0; i < num_ends; ++i) {
+    end_indexes[i] = Eigen::Vector3i(
+        static_cast<int>(std::floor((end_ps[i].x() - min_x_) / resolution_)),
+        static_cast<int>(std::floor((end_ps[i].y() - min_y_) / resolution_)),
+        static_cast<int>(std::floor((end_ps[i].z() - min_z_) / resolution_)));
+    const int end_block_index = block_index_.GetBlockId(
+        end_indexes[i].x(), end_indexes[i].y(), end_indexes[i].z());
+    int node_begin = 0;
+    int node_end = 0;
+    // Points in the start block and points that can not be reached use the
+    // Euclidean distance.
+    end_distances[i] = (end_ps[i] - start_p).norm();
+    if (end_block_index != start_block_index &&
+        graph_table_.GetBlockNodes(end_block_index, &node_begin, &node_end)) {
+      end_blocks[end_block_index].emplace_back(i);
+      ++num_pending;
+    }
+  }
+  if (num_pending == 0) {
+    return end_distances;
+  }
+  // Dijkstra from the start block until all end points are settled.
+  const int nums_node = graph_table_.nodes_.size();
+  std::vector<char> is_visited(nums_node, 0);
+  std::vector<float> distance(nums_node, 0.0);
+  std::priority_queue<std::pair<int, float>,
+                      std::vector<std::pair<int, float>>, DijkstraNodeCmp>
+      dijkstra_q;
+  int start_node_begin = 0;
+  int start_node_end = 0;
+  graph_table_.GetBlockNodes(start_block_index, &start_node_begin,
+                             &start_node_end);
+  for (int i = start_node_begin; i < start_node_end; ++i) {
+    const float edge_weight = graph_table_.nodes_[i].key_block_.GetDistance(
+        index_start_x, index_start_y, index_start_z);
+    dijkstra_q.emplace(i, edge_weight);
+    is_visited[i] = 1;
+    distance[i] = edge_weight;
+  }
+  int num_found = 0;
+  while (!dijkstra_q.empty()) {
+    const std::pair<int, float> cur_node = dijkstra_q.top();
+    dijkstra_q.pop();
+    if (is_visited[cur_node.first] == 2) {
+      continue;
+    }
+    // All end points are found and no shorter path remains.
+    if (num_found == num_pending) {
+      float max_distance = 0.0;
+      for (auto it = end_blocks.begin(); it != end_blocks.end(); ++it) {
+        for (const int i : it->second) {
+          max_distance = std::max(max_distance, end_distances[i]);
         }
       }
+      if (cur_node.second >= max_distance) {
+        break;
+      }
     }
-    if (is_path_found) {
-      std::vector<int> path_blocks;
-      int cur_node_index = end_father;
-      while (cur_node_index != -1) {
-        path_blocks.emplace_back(cur_node_index);
-        cur_node_index = father_nodes[cur_node_index];
+    is_visited[cur_node.first] = 2;
+    const float cur_distance = distance[cur_node.first];
+    const KeyBlock &key_block = graph_table_.nodes_[cur_node.first].key_block_;
+    auto end_block = end_blocks.find(key_block.block_id_);
+    if (end_block != end_blocks.end()) {
+      for (const int i : end_block->second) {
+        const float end_distance =
+            key_block.GetDistance(end_indexes[i].x(), end_indexes[i].y(),
+                                  end_indexes[i].z()) +
+            cur_distance;
+        if (!is_end_found[i]) {
+          is_end_found[i] = 1;
+          ++num_found;
+          end_distances[i] = end_distance;
+        } else if (end_distance < end_distances[i]) {
+          end_distances[i] = end_distance;
+        }
       }
-      std::cout << "[Block Astar] waypoint generated!! waypoint num: "
-                << path_blocks.size() << std::endl;
-      std::reverse(path_blocks.begin(), path_blocks.end());
-      block_path_ = path_blocks;
-      return end_distance;
-    } else {
-      std::cout << "[WARNING] no path !! from " << std::endl
-                << start_p << std::endl
-                << "to " << std::endl
-                << end_p << std::endl;
-      return (end_p - start_p).norm();
     }
+    graph_table_.ForEachEdge(cur_node.first, [&](const int neighbor_index,
+                                                 const float weight) {
+      if (is_visited[neighbor_index] == 2) {
+        return;
+      }
+      const float edge_weight = weight + cur_distance;
+      if (is_visited[neighbor_index] == 0 ||
+          edge_weight < distance[neighbor_index]) {
+        is_visited[neighbor_index] = 1;
+        distance[neighbor_index] = edge_weight;
+        dijkstra_q.emplace(neighbor_index, edge_weight);
+      }
+    });
+  }
+  return end_distances;
+}
+
+std::vector<std::vector<float>> GridAstar::BlockPathDistanceMatrix(
+    const std::vector<Eigen::Vector3f> &points) const {
+  const int num_points = points.size();
+  std::vector<std::vector<float>> cost_matrix(num_points);
+#pragma omp parallel for schedule(dynamic)
+  for (int i = 0; i < num_points; ++i) {
+    cost_matrix[i] = BlockPathDistances(points[i], points);
   }
+  return cost_matrix;
 }
 
 float GridAstar::BlockPathRefine(const std::vector<int> &block_path,
@@ -775,6 +1695,7 @@ float GridAstar::BlockPathRefine(const std::vector<int> &block_path,
   if (block_path.empty()) {
     return (end_p - start_p).norm();
   }
+  TimeTrack refine_track;
   // Determine the 3D index of the start point and end point.
   int index_start_x =
       static_cast<int>(std::floor((start_p.x() - min_x_) / resolution_));
@@ -859,34 +1780,47 @@ float GridAstar::BlockPathRefine(const std::vector<int> &block_path,
     }
     key_frames_index.emplace_back(key_frames.size() - 1);
   }
-  // iLQR Path Optimization.
+  // iLQR Path Optimization. The constraints are a linked list of slots in a
+  // pool. A key frame is inserted at most once, so the pool never grows.
   const int num_key_frames = key_frames.size();
-  int num_constraints = key_frames_index.size();
+  const int max_constraints = num_key_frames + 2;
+  std::vector<int> slot_frame;
+  slot_frame.reserve(max_constraints);
+  std::vector<int> prev_slot;
+  prev_slot.reserve(max_constraints);
+  std::vector<int> next_slot;
+  next_slot.reserve(max_constraints);
+  for (const int index : key_frames_index) {
+    prev_slot.emplace_back(slot_frame.size() - 1);
+    slot_frame.emplace_back(index);
+    next_slot.emplace_back(slot_frame.size());
+  }
+  int num_constraints = slot_frame.size();
+  const int head = 0;
+  const int tail = num_constraints - 1;
+  next_slot[tail] = -1;
   Eigen::Matrix<float, 2, 4> F;
   // clang-format off
   F <<
   1.0, 0.0, 1.0, 0.0,
   0.0, 1.0, 0.0, 1.0;
   // clang-format on
-  std::vector<Eigen::Matrix2f> K_mats;
-  K_mats.reserve(num_key_frames);
-  K_mats.resize(num_constraints, Eigen::Matrix2f::Zero());
-  std::vector<Eigen::Vector2f> k_vecs(num_key_frames, Eigen::Vector2f::Zero());
-  k_vecs.reserve(num_key_frames);
-  k_vecs.resize(num_constraints, Eigen::Vector2f::Zero());
-  std::vector<Eigen::Vector4f> xu_vecs(num_key_frames, Eigen::Vector4f::Zero());
-  xu_vecs.reserve(num_key_frames);
-  xu_vecs.resize(num_constraints, Eigen::Vector4f::Zero());
-  std::vector<Eigen::Vector2f> x_hat_vecs(num_key_frames,
+  std::vector<Eigen::Matrix2f> K_mats(max_constraints,
+                                      Eigen::Matrix2f::Zero());
+  std::vector<Eigen::Vector2f> k_vecs(max_constraints,
+                                      Eigen::Vector2f::Zero());
+  std::vector<Eigen::Vector4f> xu_vecs(max_constraints,
+                                       Eigen::Vector4f::Zero());
+  std::vector<Eigen::Vector4f> last_xu_vecs(max_constraints,
+                                            Eigen::Vector4f::Zero());
+  std::vector<Eigen::Vector2f> x_hat_vecs(max_constraints,
                                           Eigen::Vector2f::Zero());
-  x_hat_vecs.reserve(num_key_frames);
-  x_hat_vecs.resize(num_constraints, Eigen::Vector2f::Zero());
   // Construct the initial guess.
   std::cout << "Construct the initial guess..." << std::endl;
   xu_vecs[0] << index_start_y, index_start_z, 0.0, 0.0;
   x_hat_vecs[0] << index_start_y, index_start_z;
   for (int i = 1; i < num_constraints - 1; ++i) {
-    const int index = key_frames_index[i];
+    const int index = slot_frame[i];
     const int y_lb = key_frames[index].y_min_;
     const int y_ub = key_frames[index].y_max_;
     const int y_initial = (y_lb + y_ub) / 2;
@@ -901,46 +1835,64 @@ float GridAstar::BlockPathRefine(const std::vector<int> &block_path,
   xu_vecs[num_constraints - 2].block<2, 1>(2, 0) =
       xu_vecs[num_constraints - 1].block<2, 1>(0, 0) -
       xu_vecs[num_constraints - 2].block<2, 1>(0, 0);
-  std::cout << "start ilqr optimization..." << std::endl;
-  bool is_ilqr_success = false;
-  float cost_sum = 0.0;
-  float path_length = 0.0;
-  float last_path_length = path_length;
-  for (int replan = 0; !is_ilqr_success && replan < kMaxReplan; ++replan) {
-    std::cout << "replan: " << replan << std::endl;
+  auto get_delta_x = [&](const int slot) -> float {
+    return key_frame_x[slot_frame[next_slot[slot]]] -
+           key_frame_x[slot_frame[slot]];
+  };
+  // Bounds of y and z at the key frame of the slot.
+  auto get_bounds = [&](const int slot) -> Eigen::Vector4f {
+    const Block2D &key_frame = key_frames[slot_frame[slot]];
+    const int y_id = std::clamp(static_cast<int>(xu_vecs[slot](0)),
+                                key_frame.y_min_, key_frame.y_max_);
+    RangeVoxel z_range;
+    key_frame.GetRangeAtY(y_id, &z_range);
+    return Eigen::Vector4f(key_frame.y_min_ + kYBuffer,
+                           key_frame.y_max_ - kYBuffer,
+                           z_range.min_ + kZBuffer, z_range.max_ - kZBuffer);
+  };
+  auto get_path_length = [&](const int first, const int last) -> float {
+    float length = 0.0;
+    for (int k = first; k != last; k = next_slot[k]) {
+      length += std::hypot(xu_vecs[k].block<2, 1>(2, 0).norm(), get_delta_x(k));
+    }
+    return length;
+  };
+  bool is_time_out = false;
+  // Solve the constraints from first to last, starting from the current
+  // solution. The state at first is fixed and the state at last is pulled to
+  // the target.
+  auto solve = [&](const int first, const int last, const float target_y,
+                   const float target_z) {
+    x_hat_vecs[first] = xu_vecs[first].block<2, 1>(0, 0);
+    float last_path_length = 0.0;
     // Iteration Loop.
     for (int iter = 0; iter < kMaxIteration; ++iter) {
+      if (refine_track.GetPassingTime() > kRefineTimeBudget) {
+        is_time_out = true;
+        return;
+      }
       Eigen::Matrix2f V;
       Eigen::Vector2f v;
-      cost_sum = 0.0;
+      float cost_sum = 0.0;
       std::pair<float, float> delta_V(0.0, 0.0);
       // Backward Pass.
-      for (int k = num_constraints - 1; k >= 0; --k) {
+      for (int k = last; k != prev_slot[first]; k = prev_slot[k]) {
         Eigen::Matrix4f Q;
         Eigen::Vector4f q;
-        // Cost can be calculated in parallel.
-        if (k == num_constraints - 1) {
+        if (k == last) {
           const std::pair<Eigen::Matrix4f, Eigen::Vector4f> cost =
-              GetTermCost(xu_vecs[k], index_end_y, index_end_z);
-          cost_sum += GetRealTermCost(xu_vecs[k], index_end_y, index_end_z);
+              GetTermCost(xu_vecs[k], target_y, target_z);
+          cost_sum += GetRealTermCost(xu_vecs[k], target_y, target_z);
           Q = cost.first;
           q = cost.second;
         } else {
-          const int real_index = key_frames_index[k];
-          const float delta_x = key_frame_x[key_frames_index[k + 1]] -
-                                key_frame_x[key_frames_index[k]];
-          const int y_lb = key_frames[real_index].y_min_;
-          const int y_ub = key_frames[real_index].y_max_;
-          const int y_id =
-              std::clamp(static_cast<int>(xu_vecs[k](0)), y_lb, y_ub);
-          RangeVoxel z_range;
-          key_frames[real_index].GetRangeAtY(y_id, &z_range);
+          const float delta_x = get_delta_x(k);
+          const Eigen::Vector4f bounds = get_bounds(k);
           const std::pair<Eigen::Matrix4f, Eigen::Vector4f> cost =
-              GetCost(xu_vecs[k], delta_x, y_lb + kYBuffer, y_ub - kYBuffer,
-                      z_range.min_ + kZBuffer, z_range.max_ - kZBuffer);
-          cost_sum +=
-              GetRealCost(xu_vecs[k], delta_x, y_lb + kYBuffer, y_ub - kYBuffer,
-                          z_range.min_ + kZBuffer, z_range.max_ - kZBuffer);
+              GetCost(xu_vecs[k], delta_x, bounds(0), bounds(1), bounds(2),
+                      bounds(3));
+          cost_sum += GetRealCost(xu_vecs[k], delta_x, bounds(0), bounds(1),
+                                  bounds(2), bounds(3));
           Q = cost.first + F.transpose() * V * F;
           q = cost.second + F.transpose() * v;
         }
@@ -966,36 +1918,27 @@ float GridAstar::BlockPathRefine(const std::vector<int> &block_path,
       bool is_line_search_done = false;
       int line_search_iter = 0;
       // TODO: Parellel line search.
-      const std::vector<Eigen::Vector4f> cur_xu_vecs(xu_vecs);
+      for (int k = first; k != next_slot[last]; k = next_slot[k]) {
+        last_xu_vecs[k] = xu_vecs[k];
+      }
       while (!is_line_search_done && line_search_iter < kMaxLineSearchIter) {
         ++line_search_iter;
         // Forward Pass.
         float next_cost_sum = 0.0;
-        for (int k = 0; k < num_constraints - 1; ++k) {
-          const Eigen::Vector2f x = cur_xu_vecs[k].block<2, 1>(0, 0);
-          const Eigen::Vector2f u = cur_xu_vecs[k].block<2, 1>(2, 0);
+        for (int k = first; k != last; k = next_slot[k]) {
+          const Eigen::Vector2f x = last_xu_vecs[k].block<2, 1>(0, 0);
+          const Eigen::Vector2f u = last_xu_vecs[k].block<2, 1>(2, 0);
           xu_vecs[k].block<2, 1>(2, 0) =
               K_mats[k] * (x_hat_vecs[k] - x) + alpha * k_vecs[k] + u;
           xu_vecs[k].block<2, 1>(0, 0) = x_hat_vecs[k];
-          x_hat_vecs[k + 1] = F * xu_vecs[k];
+          x_hat_vecs[next_slot[k]] = F * xu_vecs[k];
           // Calculate the new cost.
-          const int real_index = key_frames_index[k];
-          const float delta_x = key_frame_x[key_frames_index[k + 1]] -
-                                key_frame_x[key_frames_index[k]];
-          const int y_lb = key_frames[real_index].y_min_;
-          const int y_ub = key_frames[real_index].y_max_;
-          const int y_id =
-              std::clamp(static_cast<int>(xu_vecs[k](0)), y_lb, y_ub);
-          RangeVoxel z_range;
-          key_frames[real_index].GetRangeAtY(y_id, &z_range);
-          next_cost_sum +=
-              GetRealCost(xu_vecs[k], delta_x, y_lb + kYBuffer, y_ub - kYBuffer,
-                          z_range.min_ + kZBuffer, z_range.max_ - kZBuffer);
+          const Eigen::Vector4f bounds = get_bounds(k);
+          next_cost_sum += GetRealCost(xu_vecs[k], get_delta_x(k), bounds(0),
+                                       bounds(1), bounds(2), bounds(3));
         }
-        xu_vecs[num_constraints - 1].block<2, 1>(0, 0) =
-            x_hat_vecs[num_constraints - 1];
-        next_cost_sum += GetRealTermCost(xu_vecs[num_constraints - 1],
-                                         index_end_y, index_end_z);
+        xu_vecs[last].block<2, 1>(0, 0) = x_hat_vecs[last];
+        next_cost_sum += GetRealTermCost(xu_vecs[last], target_y, target_z);
         // Check if J satisfy line search condition.
         const float ratio_decrease =
             (next_cost_sum - cost_sum) /
@@ -1008,14 +1951,8 @@ float GridAstar::BlockPathRefine(const std::vector<int> &block_path,
         }
       }
 
-      // Calculate the path length.
-      path_length = 0.0;
-      for (int k = 0; k < num_constraints - 1; ++k) {
-        const float delta_x = key_frame_x[key_frames_index[k + 1]] -
-                              key_frame_x[key_frames_index[k]];
-        path_length += std::hypot(xu_vecs[k].block<2, 1>(2, 0).norm(), delta_x);
-      }
       // Terminate condition.
+      const float path_length = get_path_length(first, last);
       if (iter > 0 &&
           std::fabs(path_length - last_path_length) < kConvergenceThreshold) {
         break;
@@ -1023,15 +1960,32 @@ float GridAstar::BlockPathRefine(const std::vector<int> &block_path,
         last_path_length = path_length;
       }
     }
+  };
+  std::cout << "start ilqr optimization..." << std::endl;
+  solve(head, tail, index_end_y, index_end_z);
+  // Segments that start at the slot and changed since the last check.
+  std::vector<char> is_unchecked(max_constraints, 1);
+  std::vector<char> is_new(max_constraints, 0);
+  // Invalid key frames and the slot of their segment.
+  std::vector<std::pair<int, int>> unvalid_index;
+  unvalid_index.reserve(num_key_frames);
+  std::vector<int> new_slots;
+  new_slots.reserve(num_key_frames);
+  bool is_ilqr_success = false;
+  int replan = 0;
+  for (; !is_ilqr_success && !is_time_out && replan < kMaxReplan; ++replan) {
     // Check if the path is feasible.
-    std::vector<int> unvalid_index;
-    unvalid_index.reserve(num_key_frames);
-    for (int check = 0; check < num_constraints - 1; ++check) {
+    unvalid_index.clear();
+    for (int check = head; check != tail; check = next_slot[check]) {
+      if (!is_unchecked[check]) {
+        continue;
+      }
+      is_unchecked[check] = 0;
       // Index, not x.
-      const int start_index = key_frames_index[check];
-      const int target_index = key_frames_index[check + 1];
+      const int start_index = slot_frame[check];
+      const int target_index = slot_frame[next_slot[check]];
       const Eigen::Vector4f start_xu = xu_vecs[check];
-      const Eigen::Vector4f target_xu = xu_vecs[check + 1];
+      const Eigen::Vector4f target_xu = xu_vecs[next_slot[check]];
       const Eigen::Vector4f slope =
           (target_xu - start_xu) / (target_index - start_index);
       const Eigen::Vector4f bias =
@@ -1041,70 +1995,100 @@ float GridAstar::BlockPathRefine(const std::vector<int> &block_path,
         const Block2D &block2d = key_frames[index];
         const Eigen::Vector4f xu = slope * index + bias;
         if (block2d.IsInBlock(xu(0), xu(1)) == false) {
-          unvalid_index.emplace_back(index);
-          // std::cout << "unvalid index: " << index << std::endl;
+          unvalid_index.emplace_back(index, check);
         }
       }
     }
     if (unvalid_index.empty()) {
       is_ilqr_success = true;
-    } else {
-      // Add extra constraints.
-      int unvalid_start = unvalid_index[0];
-      const int num_unvalid = unvalid_index.size();
-      for (int i = 0; i < num_unvalid; ++i) {
-        if (i == num_unvalid - 1 ||
-            unvalid_index[i] + 1 != unvalid_index[i + 1]) {
-          const int unvalid_mid = (unvalid_start + unvalid_index[i]) / 2;
-          // Insert unvalid_mid to key_frames_index.
-          const int insert_iter = std::distance(
-              key_frames_index.begin(),
-              std::lower_bound(key_frames_index.begin(), key_frames_index.end(),
-                               unvalid_mid));
-          if (key_frames_index[insert_iter] != unvalid_mid) {
-            key_frames_index.emplace(key_frames_index.begin() + insert_iter,
-                                     unvalid_mid);
-            // Update xu_vecs.
-            const int y_lb = key_frames[unvalid_mid].y_min_;
-            const int y_ub = key_frames[unvalid_mid].y_max_;
-            const int y_initial = (y_lb + y_ub) / 2;
-            RangeVoxel z_range;
-            key_frames[unvalid_mid].GetRangeAtY(y_initial, &z_range);
-            const int z_initial = (z_range.min_ + z_range.max_) / 2;
-            Eigen::Vector4f new_xu_constraint;
-            new_xu_constraint.block<2, 1>(0, 0) << y_initial, z_initial;
-            new_xu_constraint.block<2, 1>(2, 0) =
-                xu_vecs[insert_iter].block<2, 1>(0, 0) -
-                new_xu_constraint.block<2, 1>(0, 0);
-            xu_vecs[insert_iter - 1].block<2, 1>(2, 0) =
-                new_xu_constraint.block<2, 1>(0, 0) -
-                xu_vecs[insert_iter - 1].block<2, 1>(0, 0);
-            xu_vecs.emplace(xu_vecs.begin() + insert_iter, new_xu_constraint);
-          }
-          // Update unvalid_start.
-          unvalid_start = unvalid_index[i + 1];
+      break;
+    }
+    // Add extra constraints in the middle of each invalid run.
+    new_slots.clear();
+    int unvalid_start = 0;
+    const int num_unvalid = unvalid_index.size();
+    for (int i = 0; i < num_unvalid; ++i) {
+      if (i == num_unvalid - 1 ||
+          unvalid_index[i].first + 1 != unvalid_index[i + 1].first) {
+        const int run_start = unvalid_index[unvalid_start].first;
+        const int unvalid_mid = (run_start + unvalid_index[i].first) / 2;
+        const int segment =
+            unvalid_index[unvalid_start + unvalid_mid - run_start].second;
+        if (slot_frame[segment] != unvalid_mid) {
+          // Link a new slot after the segment.
+          const int slot = slot_frame.size();
+          const int next = next_slot[segment];
+          slot_frame.emplace_back(unvalid_mid);
+          prev_slot.emplace_back(segment);
+          next_slot.emplace_back(next);
+          next_slot[segment] = slot;
+          prev_slot[next] = slot;
+          // Update xu_vecs.
+          const int y_lb = key_frames[unvalid_mid].y_min_;
+          const int y_ub = key_frames[unvalid_mid].y_max_;
+          const int y_initial = (y_lb + y_ub) / 2;
+          RangeVoxel z_range;
+          key_frames[unvalid_mid].GetRangeAtY(y_initial, &z_range);
+          const int z_initial = (z_range.min_ + z_range.max_) / 2;
+          xu_vecs[slot].block<2, 1>(0, 0) << y_initial, z_initial;
+          xu_vecs[slot].block<2, 1>(2, 0) = xu_vecs[next].block<2, 1>(0, 0) -
+                                            xu_vecs[slot].block<2, 1>(0, 0);
+          xu_vecs[segment].block<2, 1>(2, 0) =
+              xu_vecs[slot].block<2, 1>(0, 0) -
+              xu_vecs[segment].block<2, 1>(0, 0);
+          is_new[slot] = 1;
+          new_slots.emplace_back(slot);
         }
+        unvalid_start = i + 1;
       }
-
-      // Resize K_mats, k_vecs, x_hat_vecs.
-      const int num_new_constraints = key_frames_index.size();
-      if (num_new_constraints == num_constraints) {
-        is_ilqr_success = true;
+    }
+    if (new_slots.empty()) {
+      is_ilqr_success = true;
+      break;
+    }
+    num_constraints += new_slots.size();
+    // Re-solve only the segments next to the new key frames. The states
+    // around them are kept, so the rest of the path stays valid.
+    for (const int slot : new_slots) {
+      if (!is_new[slot]) {
+        continue;
+      }
+      const int first = prev_slot[slot];
+      int last = next_slot[slot];
+      while (is_new[last]) {
+        last = next_slot[last];
+      }
+      for (int k = first; k != last; k = next_slot[k]) {
+        is_new[k] = 0;
+        is_unchecked[k] = 1;
+      }
+      if (last == tail) {
+        solve(first, last, index_end_y, index_end_z);
       } else {
-        K_mats.resize(num_new_constraints, Eigen::Matrix2f::Zero());
-        k_vecs.resize(num_new_constraints, Eigen::Vector2f::Zero());
-        x_hat_vecs.resize(num_new_constraints, Eigen::Vector2f::Zero());
-        num_constraints = num_new_constraints;
+        const Eigen::Vector2f target = xu_vecs[last].block<2, 1>(0, 0);
+        solve(first, last, target(0), target(1));
+        const int before = prev_slot[last];
+        xu_vecs[last].block<2, 1>(0, 0) = target;
+        xu_vecs[before].block<2, 1>(2, 0) =
+            target - xu_vecs[before].block<2, 1>(0, 0);
+      }
+      if (is_time_out) {
+        break;
       }
     }
   }
+  const float path_length = get_path_length(head, tail);
+  std::cout << "[Block Path Refine] replan: " << replan
+            << ", constraints: " << num_constraints
+            << ", time: " << refine_track.GetPassingTime() << " ms"
+            << (is_time_out ? ", time budget exceeded" : "") << std::endl;
 
   ilqr_path_.clear();
   ilqr_path_.reserve(num_constraints);
-  for (int i = 0; i < num_constraints; ++i) {
-    float x = key_frame_x[key_frames_index[i]];
-    float y = xu_vecs[i](0);
-    float z = xu_vecs[i](1);
+  for (int slot = head; slot != -1; slot = next_slot[slot]) {
+    float x = key_frame_x[slot_frame[slot]];
+    float y = xu_vecs[slot](0);
+    float z = xu_vecs[slot](1);
     ilqr_path_.emplace_back();
     ilqr_path_.back() = {x, y, z};
   }
@@ -1,6 +1,9 @@
 #include "explorer/grid_astar.h"
+#include "explorer/local_map.h"
 #include "explorer/time_track.hpp"
 #include <Eigen/Dense>
+#include <algorithm>
+#include <array>
 #include <geometry_msgs/Point.h>
 #include <octomap/octomap.h>
 #include <octomap_msgs/Octomap.h>
@@ -16,6 +19,39 @@ void octomap_cb(const octomap_msgs::Octomap::ConstPtr &msg) {
   ocmap = dynamic_cast<octomap::OcTree *>(msgToMap(*msg));
 }
 
+// Bounds of the blocks, sorted, as the block ids differ between the merges.
+std::vector<std::array<int, 6>> sorted_blocks(const GridAstar &grid_astar) {
+  std::vector<std::array<int, 6>> bounds;
+  for (const Block3D &block : grid_astar.merge_map_3d()) {
+    bounds.push_back({block.x_min_, block.x_max_, block.y_min_, block.y_max_,
+                      block.z_min_, block.z_max_});
+  }
+  std::sort(bounds.begin(), bounds.end());
+  return bounds;
+}
+
+// Edges of the graph table as the bounds of their key blocks, sorted, as the
+// node and block ids differ between the updates.
+std::vector<std::array<int, 10>> sorted_edges(const GridAstar &grid_astar) {
+  const GraphTable &graph_table = grid_astar.graph_table();
+  std::vector<std::array<int, 10>> edges;
+  const int num_nodes = graph_table.nodes_.size();
+  for (int i = 0; i < num_nodes; ++i) {
+    const KeyBlock &src = graph_table.nodes_[i].key_block_;
+    for (int e = graph_table.edge_offsets_[i];
+         e < graph_table.edge_offsets_[i + 1]; ++e) {
+      const KeyBlock &dest =
+          graph_table.nodes_[graph_table.edges_[e].dest_id_].key_block_;
+      edges.push_back({src.x_, src.block_.y_min_, src.block_.y_max_,
+                       src.block_.z_min_, src.block_.z_max_, dest.x_,
+                       dest.block_.y_min_, dest.block_.y_max_,
+                       dest.block_.z_min_, dest.block_.z_max_});
+    }
+  }
+  std::sort(edges.begin(), edges.end());
+  return edges;
+}
+
 int main(int argc, char **argv) {
   ros::init(argc, argv, "grid_astar_test");
   ros::NodeHandle nh("");
@@ -124,6 +160,12 @@ int main(int argc, char **argv) {
   const float max_z = 2.0;
   const float resolution = 0.1;
   GridAstar grid_astar(min_x, max_x, min_y, max_y, min_z, max_z, resolution);
+  // same grid updated from every leaf of the map, to compare
+  GridAstar full_astar(min_x, max_x, min_y, max_y, min_z, max_z, resolution);
+  // occupancy cache of the grid region, to find the changed voxels
+  LocalMap cycle_map;
+  LocalMap last_cycle_map;
+  bool is_first_cycle = true;
 
   std::random_device rd;
   std::mt19937 gen(rd());
@@ -142,7 +184,20 @@ int main(int argc, char **argv) {
     octomap::point3d bx_min(min_x, min_y, min_z);
     octomap::point3d bx_max(max_x, max_y, max_z);
     TimeTrack track;
-    grid_astar.UpdateFromMap(ocmap, bx_min, bx_max);
+    std::swap(last_cycle_map, cycle_map);
+    cycle_map.Update(ocmap, Eigen::Vector3f(min_x, min_y, min_z),
+                     Eigen::Vector3f(max_x, max_y, max_z), false);
+    track.OutputPassingTime("Cycle Map");
+
+    track.SetStartTime();
+    std::vector<octomap::OcTreeKey> changed_keys;
+    if (is_first_cycle) {
+      grid_astar.UpdateFromMap(ocmap, bx_min, bx_max);
+      is_first_cycle = false;
+    } else {
+      cycle_map.GetChangedKeys(last_cycle_map, &changed_keys);
+      grid_astar.UpdateFromKeys(ocmap, changed_keys, bx_min, bx_max);
+    }
     track.OutputPassingTime("Update Map");
 
     track.SetStartTime();
@@ -157,6 +212,28 @@ int main(int argc, char **argv) {
     grid_astar.MergeMap3D();
     track.OutputPassingTime("Merge Map3D");
 
+    // The incremental update and merges should match a full update and a
+    // merge from scratch.
+    track.SetStartTime();
+    full_astar.UpdateFromMap(ocmap, bx_min, bx_max);
+    GridAstar rebuilt_astar(min_x, max_x, min_y, max_y, min_z, max_z,
+                            resolution, full_astar.grid_map());
+    rebuilt_astar.MergeMap();
+    rebuilt_astar.MergeMap2D();
+    rebuilt_astar.MergeMap3D();
+    track.OutputPassingTime("Full Update And Merge");
+    const bool is_same_grid = grid_astar.grid_map() == full_astar.grid_map();
+    const bool is_same_blocks =
+        sorted_blocks(grid_astar) == sorted_blocks(rebuilt_astar);
+    const bool is_same_edges =
+        sorted_edges(grid_astar) == sorted_edges(rebuilt_astar);
+    std::cout << "[incremental update] changed voxels " << changed_keys.size()
+              << ", grid" << (is_same_grid ? " (same)" : " (differ)")
+              << ", blocks " << grid_astar.merge_map_3d().size()
+              << (is_same_blocks ? " (same)" : " (differ)") << ", edges "
+              << grid_astar.graph_table().edges_.size()
+              << (is_same_edges ? " (same)" : " (differ)") << std::endl;
+
     track.SetStartTime();
     const std::vector<std::vector<std::vector<GridAstar::GridState>>>
         &grid_map = grid_astar.grid_map();
@@ -443,8 +520,17 @@ int main(int argc, char **argv) {
 
     // A*寻路，并统计时间
     track.SetStartTime();
-    grid_astar.AstarPathDistance(start_pt, end_pt);
+    const GridAstarOutput astar_output =
+        grid_astar.AstarPathDistance(start_pt, end_pt);
     track.OutputPassingTime("--Astar Search Total--");
+
+    // JPS寻路，并统计时间
+    track.SetStartTime();
+    const GridAstarOutput jps_output =
+        grid_astar.JpsPathDistance(start_pt, end_pt);
+    track.OutputPassingTime("--JPS Search Total--");
+    std::cout << "Astar Path Length: " << astar_output.path_length
+              << ", JPS Path Length: " << jps_output.path_length << std::endl;
     // 可视化轨迹
     waypoint.points.clear();
     waypoint.color.r = 1.0;
@@ -1,156 +1,475 @@
 #include "explorer/hastar.h"
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <functional>
 #include <geometry_msgs/PoseStamped.h>
+#include <limits>
 #include <map>
 #include <memory>
-#include <queue>
 #include <string>
 #include <unordered_map>
 
 const float MAX_VEL = 0.5;
 const float MAX_ACC = 1.0;
+const vector<float> OMEGA = {-2.0, -1.0, -0.5, 0.0, 0.5, 1.0, 2.0};
+// Clearance of the primitives checked in the local map, and the number of
+// segments a primitive is sampled with.
+const float MIN_CLEARANCE = 0.4;
+const int CLEARANCE_SEGMENTS = 2;
+// The search is bounded to the bbx of start and goal expanded by
+// WINDOW_MARGIN in xy.
+const float WINDOW_MARGIN = 5.0;
+// Heuristic weight of the first anytime iteration, lowered by EPSILON_STEP
+// after each path found in time.
+const float EPSILON_START = 2.0;
+const float EPSILON_STEP = 0.5;
+// The analytic shot turns at the yaw rate of the tightest primitive and is
+// tried once every SHOT_INTERVAL expansions.
+const float SHOT_OMEGA = 2.0;
+const int SHOT_INTERVAL = 10;
 
-bool Hastar::search_path(const octomap::OcTree *ocmap,
+namespace {
+// End of a constant yaw rate arc at MAX_VEL, in the frame of its start.
+Eigen::Vector2f arc_offset(const float &omega, const float &time) {
+  if (omega * time == 0) {
+    return Eigen::Vector2f(MAX_VEL * time, 0.0);
+  }
+  const float rad = MAX_VEL / omega;
+  return Eigen::Vector2f(rad * sin(omega * time),
+                         rad * (1 - cos(omega * time)));
+}
+
+float yaw_wrap(float yaw) {
+  if (yaw > M_PI) {
+    yaw -= 2.0 * M_PI;
+  } else if (yaw < -M_PI) {
+    yaw += 2.0 * M_PI;
+  }
+  return yaw;
+}
+} // namespace
+
+bool Hastar::search_path(const LocalMap &local_map,
                          const Eigen::Vector3f &start_p,
                          const Eigen::Vector3f &end_p, const float &yaw) {
-  vector<float> omega = {-2.0, -1.0, -0.5, 0.0, 0.5, 1.0, 2.0};
-
-  priority_queue<PathNode, vector<PathNode>, NodeCmp> hastar_q;
-  vector<PathNode> closed_list;
-  // size of closed_list, maybe faster than closed_list.size()
-  int count = 0;
-  // state: 0 -> open; 1 -> closed
-
-  unordered_map<PathNode, int, NodeHash> node_state;
-  unordered_map<PathNode, float, NodeHash> node_g_score;
-
-  // map<PathNode, int, MapCmp> node_state;
-  // map<PathNode, float, MapCmp> node_g_score;
-
-  PathNode root(start_p, yaw);
-  root.father_id = -1;
-  root.g_score = 0.0;
-  root.h_score = calc_h_score(ocmap, root.position, end_p);
-  root.f_score = root.g_score + root.h_score;
-  hastar_q.push(root);
-  node_state[root] = 0;
-  node_g_score[root] = 0.0;
-  bool is_path_found = false;
-
-  while (!hastar_q.empty()) {
+  primitives_generate();
+  window_reset(start_p, end_p);
+  goal_ = end_p;
+  epsilon_ = time_budget > 0 ? EPSILON_START : 1.0;
+  best_cost_ = numeric_limits<float>::max();
+  is_partial = false;
+  num_expansions = 0;
+  roots_.clear();
+  roots_.push_back(PathNode(start_p, yaw));
+  search_restart(local_map);
+  return search_loop(local_map);
+}
+
+bool Hastar::resume_path(const LocalMap &local_map,
+                         const Eigen::Vector3f &start_p, const float &yaw) {
+  // The closed nodes of a search that ran out of nodes can not reach the goal
+  // whatever the start, the new start only expands the other states.
+  if (!is_exhausted_) {
+    return search_path(local_map, start_p, goal_, yaw);
+  }
+  // only the first pass keeps the tree, the tighter ones restart from start_p
+  epsilon_ = time_budget > 0 ? EPSILON_START : 1.0;
+  roots_.assign(1, PathNode(start_p, yaw));
+  if (!root_add(local_map, roots_.front())) {
+    return search_path(local_map, start_p, goal_, yaw);
+  }
+  is_partial = false;
+  partial_id_ = -1;
+  shot_id_ = -1;
+  return search_loop(local_map);
+}
+
+void Hastar::search_restart(const LocalMap &local_map) {
+  if (++epoch_ == 0) {
+    fill(cells_.begin(), cells_.end(), Cell());
+    epoch_ = 1;
+  }
+  node_pool_.clear();
+  node_cell_.clear();
+  open_.clear();
+  partial_id_ = -1;
+  shot_id_ = -1;
+  for (const PathNode &root : roots_) {
+    root_add(local_map, root);
+  }
+}
+
+bool Hastar::root_add(const LocalMap &local_map, const PathNode &root) {
+  const int root_cell = state_index(root.position, root.yaw);
+  if (root_cell < 0) {
+    return false;
+  }
+  Cell &cell = cells_[root_cell];
+  if (cell.epoch == epoch_) {
+    // already in the tree
+    return true;
+  }
+  cell = {epoch_, false, 0.0};
+  PathNode node(root);
+  node.father_id = -1;
+  node.primitive_id = -1;
+  node.g_score = 0.0;
+  node.h_score = calc_h_score(local_map, node.position, goal_);
+  node.f_score = node.g_score + epsilon_ * node.h_score;
+  open_.emplace_back(node.f_score, node_pool_.size());
+  push_heap(open_.begin(), open_.end(), greater<pair<float, int>>());
+  node_pool_.push_back(node);
+  node_cell_.push_back(root_cell);
+  return true;
+}
+
+bool Hastar::search_loop(const LocalMap &local_map) {
+  const auto start_time = chrono::steady_clock::now();
+  bool is_timeout = false;
+  is_exhausted_ = false;
+  while (true) {
+    const int goal_id = expand(local_map, start_time, is_timeout);
+    if (goal_id >= 0) {
+      best_cost_ = node_pool_[goal_id].g_score;
+      if (goal_id == shot_id_) {
+        best_cost_ += shot_time_;
+      }
+      path_generate(goal_id, true);
+    }
+    if (is_timeout || epsilon_ <= 1.0) {
+      break;
+    }
+    // Tighten epsilon, also when the open list ran out: the states are
+    // discretized, so a greedy search can miss a path. The nodes that can not
+    // beat the best path are pruned.
+    epsilon_ = max(1.0f, epsilon_ - EPSILON_STEP);
+    search_restart(local_map);
+  }
+
+  if (best_cost_ < numeric_limits<float>::max()) {
+    cout << "[Hastar] waypoint generated!! waypoint num: " << path.size()
+         << ", expansions: " << num_expansions << ", epsilon: " << epsilon_
+         << endl;
+    return true;
+  }
+  // a partial path needs at least one primitive
+  if (is_timeout && partial_id_ >= 0 &&
+      node_pool_[partial_id_].father_id != -1) {
+    path_generate(partial_id_, false);
+    is_partial = true;
+    cout << "[Hastar] out of time, partial waypoint num: " << path.size()
+         << endl;
+    return false;
+  }
+  is_exhausted_ = !is_timeout;
+  cout << "[Hastar] no path" << endl;
+  return false;
+}
+
+int Hastar::expand(const LocalMap &local_map,
+                   const chrono::steady_clock::time_point &start_time,
+                   bool &is_timeout) {
+  while (!open_.empty()) {
+    if (time_budget > 0 && num_expansions % 64 == 0) {
+      const chrono::duration<float, milli> elapsed =
+          chrono::steady_clock::now() - start_time;
+      if (elapsed.count() > time_budget) {
+        is_timeout = true;
+        return -1;
+      }
+    }
     // selection
-    PathNode node = hastar_q.top();
-    hastar_q.pop();
-    // add node to closed list
-    // 可以考虑将priority_queue替换为set，因为g值更新导致节点重复
-    if (node_state[node] == 1) {
+    pop_heap(open_.begin(), open_.end(), greater<pair<float, int>>());
+    const int node_id = open_.back().second;
+    open_.pop_back();
+    // g值更新导致节点重复, the cell keeps the first copy popped
+    Cell &cell = cells_[node_cell_[node_id]];
+    if (cell.closed) {
       continue;
     }
-    // closed_list[count] = node;
-    closed_list.emplace_back(node);
-    node_state[node] = 1;
-
-    // cout << (node.position - end_p).norm() << endl << endl;
-    // cout << (node.position) << node.vel << endl << endl;
+    cell.closed = true;
+    num_expansions++;
+    // the pool grows below
+    const PathNode node = node_pool_[node_id];
+    if (node.g_score + node.h_score >= best_cost_) {
+      continue;
+    }
+    if (partial_id_ < 0 || node.h_score < node_pool_[partial_id_].h_score) {
+      partial_id_ = node_id;
+    }
 
     // 终点处应当约束速度为0,此处可以用庞特里亚金求解
-    if ((node.position - end_p).norm() < 0.2) {
-      // if((node.position - end_p).norm() < 0.2){
-      is_path_found = true;
+    if ((node.position - goal_).norm() < 0.2) {
       cout << "[Hastar] find_path !!!" << endl;
-      break;
+      return node_id;
+    }
+    if (analytic_shot && (num_expansions - 1) % SHOT_INTERVAL == 0 &&
+        shot_try(local_map, node_id)) {
+      cout << "[Hastar] analytic shot !!!" << endl;
+      return node_id;
     }
 
     // expansion
     Eigen::Vector3f next_pos;
     float next_yaw;
-    for (int i = 0; i < omega.size(); ++i) {
+    const float cos_yaw = cos(node.yaw);
+    const float sin_yaw = sin(node.yaw);
+    const float next_g_score = node.g_score + tau;
+    for (int i = 0; i < primitives_.size(); ++i) {
+      const Primitive &primitive = primitives_[i];
       // 保证yaw在[-pi, pi]之间
-      next_yaw =
-          atan2(sin(node.yaw + omega[i] * tau), cos(node.yaw + omega[i] * tau));
-      if (omega[i] * tau == 0) {
-        Eigen::Vector3f start_vel = {MAX_VEL * cos(node.yaw),
-                                     MAX_VEL * sin(node.yaw), 0};
-        next_pos = node.position + start_vel * tau;
-      } else {
-        float rad = MAX_VEL / omega[i];
-        float std_x = rad * sin(omega[i] * tau);
-        float std_y = rad * (1 - cos(omega[i] * tau));
-        Eigen::Vector3f offset(cos(node.yaw) * std_x - sin(node.yaw) * std_y,
-                               sin(node.yaw) * std_x + cos(node.yaw) * std_y,
-                               0.0);
-        next_pos = node.position + offset;
-      }
-
-      // check next node is valid
-      bool is_next_node_valid = is_path_valid(ocmap, node.position, next_pos);
+      next_yaw = yaw_wrap(node.yaw + primitive.yaw_offset);
+      const Eigen::Vector2f &end_offset = primitive.end_offset;
+      next_pos = node.position +
+                 Eigen::Vector3f(cos_yaw * end_offset.x() -
+                                     sin_yaw * end_offset.y(),
+                                 sin_yaw * end_offset.x() +
+                                     cos_yaw * end_offset.y(),
+                                 0.0);
 
-      if (!is_next_node_valid) {
+      // check if node is in open/closed list before the collision check
+      const int next_cell = state_index(next_pos, next_yaw);
+      if (next_cell < 0) {
         continue;
       }
+      Cell &next = cells_[next_cell];
+      const bool is_visited = next.epoch == epoch_;
+      if (is_visited && (next.closed || next_g_score > next.g_score)) {
+        continue;
+      }
+      if (!is_path_valid(local_map, node.position, next_pos)) {
+        continue;
+      }
+      next = {epoch_, false, next_g_score};
 
       PathNode next_node(next_pos, next_yaw);
-      // check if node is in open/closed list
-      if (node_state.find(next_node) == node_state.end()) {
-        node_state[next_node] = 0;
+      next_node.father_id = node_id;
+      next_node.father_yaw_offset = primitive.yaw_offset;
+      next_node.primitive_id = i;
+      next_node.h_score = calc_h_score(local_map, next_node.position, goal_);
+      next_node.g_score = next_g_score;
+      next_node.f_score = next_node.g_score + epsilon_ * next_node.h_score;
+      open_.emplace_back(next_node.f_score, node_pool_.size());
+      push_heap(open_.begin(), open_.end(), greater<pair<float, int>>());
+      node_pool_.push_back(next_node);
+      node_cell_.push_back(next_cell);
+    }
+  }
+  return -1;
+}
+
+bool Hastar::shot_try(const LocalMap &local_map, const int &node_id) {
+  const PathNode &node = node_pool_[node_id];
+  // only shots in the distance field are cheap enough to be tried often
+  if (!local_map.has_distance() ||
+      !local_map.IsInside(node.position, MIN_CLEARANCE) ||
+      !local_map.IsInside(goal_, MIN_CLEARANCE)) {
+    return false;
+  }
+  // goal in the frame of the node, mirrored to the left
+  const float cos_yaw = cos(node.yaw);
+  const float sin_yaw = sin(node.yaw);
+  const Eigen::Vector3f delta = goal_ - node.position;
+  const float goal_x = cos_yaw * delta.x() + sin_yaw * delta.y();
+  const float goal_y = -sin_yaw * delta.x() + cos_yaw * delta.y();
+  const float side = goal_y < 0 ? -1.0 : 1.0;
+  // tangent from the turning circle centered at (0, rad) through the goal
+  const float rad = MAX_VEL / SHOT_OMEGA;
+  const float center_x = goal_x;
+  const float center_y = side * goal_y - rad;
+  const float center_dist2 = center_x * center_x + center_y * center_y;
+  if (center_dist2 <= rad * rad) {
+    return false;
+  }
+  const float line = sqrt(center_dist2 - rad * rad);
+  float turn = atan2(center_y, center_x) + atan2(rad, line);
+  if (turn < 0) {
+    turn += 2.0 * M_PI;
+  }
+  const float shot_time = (turn * rad + line) / MAX_VEL;
+  if (node.g_score + shot_time >= best_cost_) {
+    return false;
+  }
+
+  // (omega, duration) of the turn and the line, the samples are only made
+  // for a shot without collision
+  const float segments[2][2] = {{side * SHOT_OMEGA, turn / SHOT_OMEGA},
+                                {0.0, line / MAX_VEL}};
+  // Inside the distance field the shot advances by the clearance left over
+  // MIN_CLEARANCE, at least one primitive check step. The field counts the
+  // unknown voxels as free and misses the occupied voxels outside the box, so
+  // the step also stays within the xy distance to the border, and the voxels
+  // along it are checked every min_step. The shot is flat, IsInside keeps it
+  // away from the z border. Elsewhere it is checked like the primitives, one
+  // every tau.
+  const float min_step = MAX_VEL * tau / CLEARANCE_SEGMENTS;
+  const Eigen::Vector3f &bbx_min = local_map.bbx_min();
+  const Eigen::Vector3f &bbx_max = local_map.bbx_max();
+  Eigen::Vector3f seg_start = node.position;
+  float seg_yaw = node.yaw;
+  Eigen::Vector3f last = seg_start;
+  for (const auto &segment : segments) {
+    const float seg_cos = cos(seg_yaw);
+    const float seg_sin = sin(seg_yaw);
+    auto position_at = [&](const float &t) -> Eigen::Vector3f {
+      const Eigen::Vector2f offset = arc_offset(segment[0], t);
+      return seg_start + Eigen::Vector3f(seg_cos * offset.x() -
+                                             seg_sin * offset.y(),
+                                         seg_sin * offset.x() +
+                                             seg_cos * offset.y(),
+                                         0.0);
+    };
+    float time = 0.0;
+    while (time < segment[1]) {
+      const bool is_traced = local_map.has_distance() &&
+                             local_map.IsInside(last, MIN_CLEARANCE);
+      const float last_time = time;
+      if (is_traced) {
+        const float clearance = local_map.GetDistance(last);
+        if (clearance < MIN_CLEARANCE ||
+            local_map.GetState(last) != LocalMap::VoxelState::kFree) {
+          return false;
+        }
+        const float border = min(min(last.x() - bbx_min.x(),
+                                     bbx_max.x() - last.x()),
+                                 min(last.y() - bbx_min.y(),
+                                     bbx_max.y() - last.y()));
+        time += max(min(clearance, border) - MIN_CLEARANCE, min_step) / MAX_VEL;
       } else {
-        if (node_state[next_node] == 0 &&
-            node.g_score + tau > node_g_score[next_node]) {
-          continue;
+        time += tau;
+      }
+      const float end_time = min(time, segment[1]);
+      const Eigen::Vector3f next = position_at(end_time);
+      if (is_traced) {
+        for (float check_time = last_time + min_step / MAX_VEL;
+             check_time < end_time; check_time += min_step / MAX_VEL) {
+          if (local_map.GetState(position_at(check_time)) !=
+              LocalMap::VoxelState::kFree) {
+            return false;
+          }
         }
+      } else if (!is_path_valid(local_map, last, next)) {
+        return false;
       }
-      next_node.father_id = count;
-      next_node.father_yaw_offset = omega[i] * tau;
-      next_node.h_score = calc_h_score(ocmap, next_node.position, end_p);
-      next_node.g_score = node.g_score + tau;
-      node_g_score[next_node] = next_node.g_score;
-      next_node.f_score = next_node.g_score + next_node.h_score;
-      hastar_q.push(next_node);
+      last = next;
     }
-
-    count++;
+    seg_start = last;
+    seg_yaw += segment[0] * segment[1];
   }
+  // the end of the shot
+  if (!is_path_valid(local_map, last, last)) {
+    return false;
+  }
+  shot_.clear();
+  if (turn * rad > 1e-3) {
+    shot_.push_back(primitive_make(segments[0][0], segments[0][1]));
+  }
+  shot_.push_back(primitive_make(segments[1][0], segments[1][1]));
+  shot_id_ = node_id;
+  shot_time_ = shot_time;
+  return true;
+}
 
-  if (is_path_found) {
-    path.clear();
-
-    float end_yaw = atan2(end_p.y() - closed_list[count].position.y(),
-                          end_p.x() - closed_list[count].position.x());
+void Hastar::path_generate(const int &goal_id, const bool &is_complete) {
+  path.clear();
+  if (is_complete && goal_id == shot_id_) {
+    // nodes at the end of the shot segments, backwards like the rest
+    vector<PathNode> shot_path;
+    PathNode from = node_pool_[goal_id];
+    for (int i = 0; i < shot_.size(); ++i) {
+      const float cos_yaw = cos(from.yaw);
+      const float sin_yaw = sin(from.yaw);
+      const Eigen::Vector2f &offset = shot_[i].end_offset;
+      PathNode to(from.position +
+                      Eigen::Vector3f(cos_yaw * offset.x() -
+                                          sin_yaw * offset.y(),
+                                      sin_yaw * offset.x() +
+                                          cos_yaw * offset.y(),
+                                      0.0),
+                  yaw_wrap(from.yaw + shot_[i].yaw_offset));
+      to.father_yaw_offset = shot_[i].yaw_offset;
+      to.primitive_id = primitives_.size() + i;
+      shot_path.push_back(to);
+      from = to;
+    }
+    shot_path.back().position = goal_;
+    path.insert(path.end(), shot_path.rbegin(), shot_path.rend());
+  } else if (is_complete) {
+    const PathNode &goal = node_pool_[goal_id];
+    float end_yaw = atan2(goal_.y() - goal.position.y(),
+                          goal_.x() - goal.position.x());
     // add accurate end point
-    PathNode end(end_p, end_yaw);
+    PathNode end(goal_, end_yaw);
     path.push_back(end);
+  }
+  for (int id = goal_id; id != -1; id = node_pool_[id].father_id) {
+    path.push_back(node_pool_[id]);
+  }
+  reverse(path.begin(), path.end());
+  trajectory_generate(path.front().yaw);
+}
 
-    int id = closed_list[count].father_id;
-    path.push_back(closed_list[count]);
-    while (id != -1) {
-      path.push_back(closed_list[id]);
-      id = closed_list[id].father_id;
+void Hastar::window_reset(const Eigen::Vector3f &start_p,
+                          const Eigen::Vector3f &end_p) {
+  const Eigen::Vector3f margin(WINDOW_MARGIN, WINDOW_MARGIN, 0.0);
+  const Eigen::Vector3f window_min = start_p.cwiseMin(end_p) - margin;
+  const Eigen::Vector3f window_max = start_p.cwiseMax(end_p) + margin;
+  for (int axis = 0; axis < 3; ++axis) {
+    // same truncation as NodeHash
+    window_min_(axis) = (int)(window_min(axis) / 0.1);
+    window_size_(axis) = (int)(window_max(axis) / 0.1) - window_min_(axis) + 1;
+  }
+  const int num_cells = window_size_.prod() * YAW_BINS;
+  if (cells_.size() < num_cells) {
+    cells_.resize(num_cells);
+  }
+}
+
+int Hastar::state_index(const Eigen::Vector3f &position,
+                        const float &yaw) const {
+  // same key as NodeHash
+  int index = static_cast<int>(round(kDiv * yaw / PI)) + (YAW_BINS - 1) / 2;
+  if (index < 0 || index >= YAW_BINS) {
+    return -1;
+  }
+  int stride = YAW_BINS;
+  for (int axis = 0; axis < 3; ++axis) {
+    const int key = (int)(position(axis) / 0.1) - window_min_(axis);
+    if (key < 0 || key >= window_size_(axis)) {
+      return -1;
     }
-    reverse(path.begin(), path.end());
-    cout << "[Hastar] waypoint generated!! waypoint num: " << path.size()
-         << endl;
-    trajectory_generate(yaw);
-    return true;
-  } else {
-    cout << "[Hastar] no path" << endl;
-    return false;
+    index += key * stride;
+    stride *= window_size_(axis);
   }
+  return index;
 }
 
-float Hastar::calc_h_score(const octomap::OcTree *ocmap,
+float Hastar::calc_h_score(const LocalMap &local_map,
                            const Eigen::Vector3f &start_p,
                            const Eigen::Vector3f &end_p) {
   return (end_p - start_p).norm() / MAX_VEL;
 }
 
-bool Hastar::is_path_valid(const octomap::OcTree *ocmap,
+bool Hastar::is_path_valid(const LocalMap &local_map,
                            const Eigen::Vector3f &cur_pos,
                            const Eigen::Vector3f &next_pos) {
-  octomap::point3d next_pos_check(next_pos.x(), next_pos.y(), next_pos.z());
-  octomap::OcTreeNode *oc_node = ocmap->search(next_pos_check);
-  if (oc_node == nullptr)
+  // The chord of a primitive is MAX_VEL * tau, so a few clearance lookups
+  // replace the octree searches over the inflated bbx.
+  if (local_map.has_distance() && local_map.IsInside(cur_pos, MIN_CLEARANCE) &&
+      local_map.IsInside(next_pos, MIN_CLEARANCE)) {
+    // the field counts the unknown voxels as free
+    for (int i = 0; i <= CLEARANCE_SEGMENTS; ++i) {
+      const Eigen::Vector3f check =
+          cur_pos + (next_pos - cur_pos) * i / CLEARANCE_SEGMENTS;
+      if (local_map.GetState(check) == LocalMap::VoxelState::kUnknown ||
+          local_map.GetDistance(check) < MIN_CLEARANCE)
+        return false;
+    }
+    return true;
+  }
+
+  if (local_map.GetState(next_pos) == LocalMap::VoxelState::kUnknown)
     return false;
 
   float bbx_x0 = min(cur_pos.x(), next_pos.x()) - 0.4;
@@ -163,9 +482,8 @@ bool Hastar::is_path_valid(const octomap::OcTree *ocmap,
   for (float check_x = bbx_x0; check_x <= bbx_x1; check_x += 0.1) {
     for (float check_y = bbx_y0; check_y <= bbx_y1; check_y += 0.1) {
       for (float check_z = bbx_z0; check_z <= bbx_z1; check_z += 0.1) {
-        octomap::point3d check(check_x, check_y, check_z);
-        octomap::OcTreeNode *oc_node = ocmap->search(check);
-        if (oc_node != nullptr && ocmap->isNodeOccupied(oc_node)) {
+        const Eigen::Vector3f check(check_x, check_y, check_z);
+        if (local_map.GetState(check) == LocalMap::VoxelState::kOcc) {
           return false;
         }
       }
@@ -180,58 +498,90 @@ bool Hastar::is_path_valid(const octomap::OcTree *ocmap,
 //     return true;
 // }
 
+void Hastar::primitives_generate() {
+  if (!primitives_.empty() && primitives_tau_ == tau &&
+      primitives_sample_ == traj_sample) {
+    return;
+  }
+  primitives_tau_ = tau;
+  primitives_sample_ = traj_sample;
+  primitives_.clear();
+  for (const float omega : OMEGA) {
+    primitives_.push_back(primitive_make(omega, tau));
+  }
+}
+
+Primitive Hastar::primitive_make(const float &omega,
+                                 const float &duration) const {
+  Primitive primitive;
+  primitive.omega = omega;
+  primitive.duration = duration;
+  primitive.yaw_offset = omega * duration;
+  primitive.end_offset = arc_offset(omega, duration);
+  // turning radius MAX_VEL / omega
+  const float rad = MAX_VEL / omega;
+  for (float time = 0.0; time < duration; time += traj_sample) {
+    const float delta_yaw = primitive.yaw_offset * time / duration;
+    primitive.sample_yaw_offset.push_back(delta_yaw);
+    primitive.sample_vel.emplace_back(MAX_VEL * cos(delta_yaw),
+                                      MAX_VEL * sin(delta_yaw));
+    if (primitive.yaw_offset == 0) {
+      primitive.sample_pos.emplace_back(MAX_VEL * time, 0.0);
+      primitive.sample_acc.emplace_back(0.0, 0.0);
+    } else {
+      primitive.sample_pos.emplace_back(rad * sin(delta_yaw),
+                                        rad * (1 - cos(delta_yaw)));
+      const float acc_yaw = delta_yaw + M_PI / 2.0;
+      primitive.sample_acc.emplace_back(MAX_VEL * MAX_VEL / rad * cos(acc_yaw),
+                                        MAX_VEL * MAX_VEL / rad * sin(acc_yaw));
+    }
+  }
+  return primitive;
+}
+
+const Primitive &Hastar::primitive_get(const int &id) const {
+  return id < primitives_.size() ? primitives_[id]
+                                 : shot_[id - primitives_.size()];
+}
+
 bool Hastar::trajectory_generate(const float &yaw) {
   traj.clear();
-  if (path.size() > 2) {
-    for (int i = 0; i < path.size() - 2; i++) {
-      for (float time = 0.0; time < tau; time += traj_sample) {
-        Traj traj_point;
-        traj_point.yaw =
-            path[i].yaw + path[i + 1].father_yaw_offset * time / tau;
-        traj_point.vel << MAX_VEL * cos(traj_point.yaw),
-            MAX_VEL * sin(traj_point.yaw), 0.0;
-        if (path[i + 1].father_yaw_offset == 0) {
-          Eigen::Vector3f start_vel = {MAX_VEL * cos(path[i].yaw),
-                                       MAX_VEL * sin(path[i].yaw), 0.0};
-          traj_point.pos = path[i].position + start_vel * time;
-          traj_point.acc = Eigen::Vector3f::Zero();
-          traj_point.yaw_rate = 0.0;
-        } else {
-          float delta_yaw = path[i + 1].father_yaw_offset * time / tau;
-          float rad = MAX_VEL * time / delta_yaw;
-          float std_x = rad * sin(delta_yaw);
-          float std_y = rad * (1 - cos(delta_yaw));
-          Eigen::Vector3f offset(
-              cos(path[i].yaw) * std_x - sin(path[i].yaw) * std_y,
-              sin(path[i].yaw) * std_x + cos(path[i].yaw) * std_y, 0.0);
-          traj_point.pos = path[i].position + offset;
-          float new_yaw = traj_point.yaw + M_PI / 2.0;
-          traj_point.acc << MAX_VEL * MAX_VEL / rad * cos(new_yaw),
-              MAX_VEL * MAX_VEL / rad * sin(new_yaw), 0.0;
-          traj_point.yaw_rate = path[i + 1].father_yaw_offset / tau;
-        }
-        traj.push_back(traj_point);
-      }
+  if (path.size() < 2) {
+    return false;
+  }
+  for (int i = 0; i < path.size() - 1; i++) {
+    // the accurate end point is not reached by a primitive
+    if (path[i + 1].primitive_id < 0) {
+      continue;
+    }
+    const Primitive &primitive = primitive_get(path[i + 1].primitive_id);
+    const float cos_yaw = cos(path[i].yaw);
+    const float sin_yaw = sin(path[i].yaw);
+    // from the frame of path[i] to the map
+    auto rotate = [&](const Eigen::Vector2f &v) {
+      return Eigen::Vector3f(cos_yaw * v.x() - sin_yaw * v.y(),
+                             sin_yaw * v.x() + cos_yaw * v.y(), 0.0);
+    };
+    for (int j = 0; j < primitive.sample_pos.size(); j++) {
+      Traj traj_point;
+      traj_point.yaw = path[i].yaw + primitive.sample_yaw_offset[j];
+      traj_point.pos = path[i].position + rotate(primitive.sample_pos[j]);
+      traj_point.vel = rotate(primitive.sample_vel[j]);
+      traj_point.acc = rotate(primitive.sample_acc[j]);
+      traj_point.yaw_rate = primitive.omega;
+      traj.push_back(traj_point);
     }
-    Traj traj_point;
-    traj_point.acc = Eigen::Vector3f::Zero();
-    traj_point.vel = Eigen::Vector3f::Zero();
-    traj_point.pos = path.back().position;
-    // keep yaw constant
-    traj_point.yaw = traj.back().yaw;
-    traj.push_back(traj_point);
+  }
+  Traj traj_point;
+  traj_point.acc = Eigen::Vector3f::Zero();
+  traj_point.vel = Eigen::Vector3f::Zero();
+  traj_point.pos = path.back().position;
+  // keep yaw constant
+  traj_point.yaw = traj.empty() ? yaw : traj.back().yaw;
+  traj.push_back(traj_point);
+  if (path.size() > 2) {
     cout << "[Hastar] Traj generate OK!! traj point num: " << traj.size()
          << endl;
-  } else if (path.size() == 2) {
-    Traj traj_point;
-    traj_point.acc = Eigen::Vector3f::Zero();
-    traj_point.vel = Eigen::Vector3f::Zero();
-    traj_point.pos = path.back().position;
-    // keep yaw constant
-    traj_point.yaw = yaw;
-    traj.push_back(traj_point);
-  } else {
-    return false;
   }
   return true;
 }
@@ -158,6 +158,18 @@ void JPSPlanner<Dim>::updateMap() {
         for( int x = 0; x < dim(0); ++x)
           cmap_[x+y*dim(0)] = map_util_->isOccupied(Veci<Dim>(x,y)) ? 1:0;
   }
+  cmap_data_ = cmap_.data();
+}
+
+template <int Dim>
+void JPSPlanner<Dim>::updateMapView() {
+  cmap_.clear();
+  cmap_data_ = reinterpret_cast<const char *>(map_util_->getMapData());
+}
+
+template <int Dim>
+void JPSPlanner<Dim>::setJumpTable(const std::shared_ptr<JPS::JumpTable>& jump_table) {
+  jump_table_ = jump_table;
 }
 
 template <int Dim>
@@ -198,7 +210,7 @@ bool JPSPlanner<Dim>::plan(const Vecf<Dim> &start, const Vecf<Dim> &goal, decima
     return false;
   }
 
-  if(cmap_.empty()) {
+  if(cmap_data_ == nullptr) {
     if(planner_verbose_)
       printf(ANSI_COLOR_RED "need to set cmap, call updateMap()!\n" ANSI_COLOR_RESET);
     return -1;
@@ -207,11 +219,12 @@ bool JPSPlanner<Dim>::plan(const Vecf<Dim> &start, const Vecf<Dim> &goal, decima
   const Veci<Dim> dim = map_util_->getDim();
 
   if(Dim == 3) {
-    graph_search_ = std::make_shared<JPS::GraphSearch>(cmap_.data(), dim(0), dim(1), dim(2), eps, planner_verbose_);
+    graph_search_ = std::make_shared<JPS::GraphSearch>(cmap_data_, dim(0), dim(1), dim(2), eps, planner_verbose_);
+    graph_search_->setJumpTable(jump_table_.get());
     graph_search_->plan(start_int(0), start_int(1), start_int(2), goal_int(0), goal_int(1), goal_int(2), use_jps);
   }
   else {
-    graph_search_ = std::make_shared<JPS::GraphSearch>(cmap_.data(), dim(0), dim(1), eps, planner_verbose_);
+    graph_search_ = std::make_shared<JPS::GraphSearch>(cmap_data_, dim(0), dim(1), eps, planner_verbose_);
     graph_search_->plan(start_int(0), start_int(1), goal_int(0),  goal_int(1), use_jps);
   }
 
@@ -0,0 +1,100 @@
+#include <jps_planner/jps_planner/jump_table.h>
+#include <algorithm>
+
+using namespace JPS;
+
+void JumpTable::build(const char* cMap, int xDim, int yDim, int zDim) {
+  cMap_ = cMap;
+  dim_[0] = xDim;
+  dim_[1] = yDim;
+  dim_[2] = zDim;
+  stride_[0] = 1;
+  stride_[1] = xDim;
+  stride_[2] = xDim * yDim;
+  for (auto& dist : dist_)
+    dist.assign(xDim * yDim * zDim, 0);
+  update(0, 0, 0, xDim - 1, yDim - 1, zDim - 1);
+}
+
+void JumpTable::update(int x_min, int y_min, int z_min, int x_max, int y_max, int z_max) {
+  const int box_min[3] = {x_min, y_min, z_min};
+  const int box_max[3] = {x_max, y_max, z_max};
+  for (int axis = 0; axis < 3; ++axis) {
+    // A cell stops the jumps on its line and, as a forced neighbor, on the 8
+    // lines around it
+    const int a = (axis + 1) % 3;
+    const int b = (axis + 2) % 3;
+    const int a_min = std::max(box_min[a] - 1, 0);
+    const int a_max = std::min(box_max[a] + 1, dim_[a] - 1);
+    const int b_min = std::max(box_min[b] - 1, 0);
+    const int b_max = std::min(box_max[b] + 1, dim_[b] - 1);
+    int coord[3];
+    coord[axis] = 0;
+    for (coord[a] = a_min; coord[a] <= a_max; ++coord[a]) {
+      for (coord[b] = b_min; coord[b] <= b_max; ++coord[b])
+        buildLine(axis, coord);
+    }
+  }
+}
+
+bool JumpTable::matches(const char* cMap, int xDim, int yDim, int zDim) const {
+  return cMap_ == cMap && dim_[0] == xDim && dim_[1] == yDim && dim_[2] == zDim;
+}
+
+int JumpTable::distance(int x, int y, int z, int dx, int dy, int dz) const {
+  const int axis = dx != 0 ? 0 : (dy != 0 ? 1 : 2);
+  const int sign = dx + dy + dz;
+  const uint8_t* dist = dist_[2 * axis + (sign > 0 ? 0 : 1)].data();
+  const int step = sign * stride_[axis];
+  int id = x * stride_[0] + y * stride_[1] + z * stride_[2];
+  int steps = 0;
+  // A saturated distance means that at least kMaxStep - 1 cells ahead are free
+  // and stop no jump
+  while (dist[id] == kMaxStep) {
+    steps += kMaxStep - 1;
+    id += (kMaxStep - 1) * step;
+  }
+  return steps + dist[id];
+}
+
+void JumpTable::buildLine(int axis, const int coord[3]) {
+  const int a = (axis + 1) % 3;
+  const int b = (axis + 2) % 3;
+  const int len = dim_[axis];
+  const int step = stride_[axis];
+  const int start = coord[a] * stride_[a] + coord[b] * stride_[b];
+
+  // The forced neighbors of a straight move are the 8 cells around it
+  int offsets[8];
+  int num_offsets = 0;
+  for (int i = -1; i <= 1; ++i) {
+    for (int j = -1; j <= 1; ++j) {
+      if ((i == 0 && j == 0) || coord[a] + i < 0 || coord[a] + i >= dim_[a] ||
+          coord[b] + j < 0 || coord[b] + j >= dim_[b])
+        continue;
+      offsets[num_offsets++] = i * stride_[a] + j * stride_[b];
+    }
+  }
+
+  line_stop_.resize(len);
+  line_dist_.resize(len);
+  for (int t = 0; t < len; ++t) {
+    const int id = start + t * step;
+    bool stop = cMap_[id] != val_free_;
+    for (int k = 0; k < num_offsets && !stop; ++k)
+      stop = cMap_[id + offsets[k]] > val_free_;
+    line_stop_[t] = stop;
+  }
+
+  // Cells past the ends of the line are not free, so they stop the jumps
+  uint8_t* dist = dist_[2 * axis].data();
+  for (int t = len - 1; t >= 0; --t) {
+    line_dist_[t] = t + 1 == len || line_stop_[t + 1] ? 1 : line_dist_[t + 1] + 1;
+    dist[start + t * step] = std::min(line_dist_[t], kMaxStep);
+  }
+  dist = dist_[2 * axis + 1].data();
+  for (int t = 0; t < len; ++t) {
+    line_dist_[t] = t == 0 || line_stop_[t - 1] ? 1 : line_dist_[t - 1] + 1;
+    dist[start + t * step] = std::min(line_dist_[t], kMaxStep);
+  }
+}
@@ -0,0 +1,265 @@
+#include "explorer/leaf_graph.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+
+namespace {
+// Face probes, (axis, sign).
+const int kFaces[6][2] = {{0, -1}, {0, 1}, {1, -1}, {1, 1}, {2, -1}, {2, 1}};
+
+// First key of the aligned cube of size voxels holding key.
+Eigen::Vector3i KeyAlign(const Eigen::Vector3i &key, const int size) {
+  return key.unaryExpr([size](const int k) { return k & ~(size - 1); });
+}
+} // namespace
+
+uint64_t LeafGraph::BlockHash(const Eigen::Vector3i &key) {
+  return static_cast<uint64_t>(key.x()) |
+         (static_cast<uint64_t>(key.y()) << 16) |
+         (static_cast<uint64_t>(key.z()) << 32);
+}
+
+void LeafGraph::Build(const octomap::OcTree *ocmap) {
+  ocmap_ = ocmap;
+  resolution_ = ocmap->getResolution();
+  resolution_factor_ = 1.0 / ocmap->getResolution();
+  blocks_.clear();
+  block_at_.clear();
+  std::vector<Eigen::Vector3i> block_keys;
+  BlockKeysCollect(ocmap->getRoot(), Eigen::Vector3i::Zero(), kTreeSize,
+                   &block_keys);
+  blocks_.resize(block_keys.size());
+  for (int b = 0; b < block_keys.size(); ++b) {
+    blocks_[b].key = block_keys[b];
+    block_at_[BlockHash(block_keys[b])] = b;
+  }
+  // The leaves of all blocks are needed before the probes.
+#pragma omp parallel for schedule(dynamic)
+  for (int b = 0; b < blocks_.size(); ++b) {
+    BlockBuild(&blocks_[b]);
+  }
+#pragma omp parallel for schedule(dynamic)
+  for (int b = 0; b < blocks_.size(); ++b) {
+    BlockLink(&blocks_[b]);
+  }
+  CsrBuild();
+}
+
+void LeafGraph::Update(const octomap::OcTree *ocmap,
+                       const std::vector<octomap::OcTreeKey> &keys) {
+  if (ocmap_ == nullptr) {
+    Build(ocmap);
+    return;
+  }
+  // The unchanged blocks are the same in the new octree.
+  ocmap_ = ocmap;
+  std::unordered_set<int> dirty;
+  for (const octomap::OcTreeKey &changed_key : keys) {
+    const Eigen::Vector3i key = KeyAlign(
+        Eigen::Vector3i(changed_key[0], changed_key[1], changed_key[2]),
+        kBlockSize);
+    auto [block_it, is_new] = block_at_.emplace(BlockHash(key), blocks_.size());
+    if (is_new) {
+      blocks_.emplace_back();
+      blocks_.back().key = key;
+    }
+    dirty.insert(block_it->second);
+  }
+  if (dirty.empty()) {
+    return;
+  }
+  // The edges found by the face neighbors point into the dirty blocks too.
+  std::unordered_set<int> linked = dirty;
+  for (const int b : dirty) {
+    for (const auto &face : kFaces) {
+      Eigen::Vector3i key = blocks_[b].key;
+      key(face[0]) += face[1] * kBlockSize;
+      const auto block_it = block_at_.find(BlockHash(key));
+      if (block_it != block_at_.end()) {
+        linked.insert(block_it->second);
+      }
+    }
+  }
+  const std::vector<int> dirty_ids(dirty.begin(), dirty.end());
+  const std::vector<int> linked_ids(linked.begin(), linked.end());
+#pragma omp parallel for schedule(dynamic)
+  for (int i = 0; i < dirty_ids.size(); ++i) {
+    BlockBuild(&blocks_[dirty_ids[i]]);
+  }
+#pragma omp parallel for schedule(dynamic)
+  for (int i = 0; i < linked_ids.size(); ++i) {
+    BlockLink(&blocks_[linked_ids[i]]);
+  }
+  CsrBuild();
+}
+
+int LeafGraph::Find(const Eigen::Vector3f &p) const {
+  Eigen::Vector3i key;
+  for (int axis = 0; axis < 3; ++axis) {
+    key(axis) = static_cast<int>(std::floor(p(axis) * resolution_factor_)) +
+                kTreeMaxVal;
+    if (key(axis) < 0 || key(axis) >= kTreeSize) {
+      return -1;
+    }
+  }
+  const LeafRef ref = FindKey(key);
+  return ref.block < 0 ? -1 : block_offsets_[ref.block] + ref.index;
+}
+
+void LeafGraph::BlockKeysCollect(
+    const octomap::OcTreeNode *node, const Eigen::Vector3i &key,
+    const int size, std::vector<Eigen::Vector3i> *block_keys) const {
+  if (size == kBlockSize) {
+    block_keys->push_back(key);
+    return;
+  }
+  if (!ocmap_->nodeHasChildren(node)) {
+    // A leaf larger than a block, split if it is free.
+    if (ocmap_->isNodeOccupied(node)) {
+      return;
+    }
+    for (int k = 0; k < size; k += kBlockSize) {
+      for (int j = 0; j < size; j += kBlockSize) {
+        for (int i = 0; i < size; i += kBlockSize) {
+          block_keys->push_back(key + Eigen::Vector3i(i, j, k));
+        }
+      }
+    }
+    return;
+  }
+  const int half_size = size / 2;
+  for (int c = 0; c < 8; ++c) {
+    if (ocmap_->nodeChildExists(node, c)) {
+      BlockKeysCollect(ocmap_->getNodeChild(node, c),
+                       key + half_size * Eigen::Vector3i(c & 1, (c >> 1) & 1,
+                                                         (c >> 2) & 1),
+                       half_size, block_keys);
+    }
+  }
+}
+
+void LeafGraph::BlockBuild(Block *block) const {
+  block->leaves.clear();
+  block->voxel_leaves.assign(kBlockSize * kBlockSize * kBlockSize, -1);
+  const octomap::OcTreeNode *node = ocmap_->getRoot();
+  int size = kTreeSize;
+  while (node != nullptr && size > kBlockSize &&
+         ocmap_->nodeHasChildren(node)) {
+    size /= 2;
+    const int c = ((block->key.x() & size) != 0) +
+                  2 * ((block->key.y() & size) != 0) +
+                  4 * ((block->key.z() & size) != 0);
+    node = ocmap_->nodeChildExists(node, c) ? ocmap_->getNodeChild(node, c)
+                                            : nullptr;
+  }
+  // A larger leaf is clipped to the block.
+  if (node != nullptr) {
+    LeavesCollect(node, block->key, kBlockSize, block);
+  }
+}
+
+void LeafGraph::LeavesCollect(const octomap::OcTreeNode *node,
+                              const Eigen::Vector3i &key, const int size,
+                              Block *block) const {
+  if (!ocmap_->nodeHasChildren(node)) {
+    if (ocmap_->isNodeOccupied(node)) {
+      return;
+    }
+    Leaf leaf;
+    leaf.key = key;
+    leaf.size = size;
+    leaf.center = ((key.array() - kTreeMaxVal).cast<float>() + 0.5 * size) *
+                  resolution_;
+    const Eigen::Vector3i offset = key - block->key;
+    for (int k = offset.z(); k < offset.z() + size; ++k) {
+      for (int j = offset.y(); j < offset.y() + size; ++j) {
+        const int row = kBlockSize * (j + kBlockSize * k);
+        std::fill(block->voxel_leaves.begin() + row + offset.x(),
+                  block->voxel_leaves.begin() + row + offset.x() + size,
+                  block->leaves.size());
+      }
+    }
+    block->leaves.push_back(leaf);
+    return;
+  }
+  const int half_size = size / 2;
+  for (int c = 0; c < 8; ++c) {
+    if (ocmap_->nodeChildExists(node, c)) {
+      LeavesCollect(ocmap_->getNodeChild(node, c),
+                    key + half_size * Eigen::Vector3i(c & 1, (c >> 1) & 1,
+                                                      (c >> 2) & 1),
+                    half_size, block);
+    }
+  }
+}
+
+void LeafGraph::BlockLink(Block *block) const {
+  block->edges.clear();
+  for (int i = 0; i < block->leaves.size(); ++i) {
+    const Leaf &leaf = block->leaves[i];
+    for (const auto &face : kFaces) {
+      // The leaves are aligned cubes, so a neighbor at least as large holds
+      // the whole face and is found from the first voxel past it.
+      Eigen::Vector3i probe = leaf.key;
+      probe(face[0]) += face[1] > 0 ? leaf.size : -1;
+      if (probe(face[0]) < 0 || probe(face[0]) >= kTreeSize) {
+        continue;
+      }
+      const LeafRef ref = FindKey(probe);
+      if (ref.block < 0) {
+        continue;
+      }
+      const int next_size = blocks_[ref.block].leaves[ref.index].size;
+      if (next_size < leaf.size || (next_size == leaf.size && face[1] < 0)) {
+        continue;
+      }
+      block->edges.emplace_back(i, ref);
+    }
+  }
+}
+
+LeafGraph::LeafRef LeafGraph::FindKey(const Eigen::Vector3i &key) const {
+  const Eigen::Vector3i block_key = KeyAlign(key, kBlockSize);
+  const auto block_it = block_at_.find(BlockHash(block_key));
+  if (block_it == block_at_.end()) {
+    return {-1, -1};
+  }
+  const Block &block = blocks_[block_it->second];
+  const Eigen::Vector3i offset = key - block_key;
+  const int index = block.voxel_leaves[offset.x() +
+                                       kBlockSize * (offset.y() +
+                                                     kBlockSize * offset.z())];
+  return {index < 0 ? -1 : block_it->second, index};
+}
+
+void LeafGraph::CsrBuild() {
+  block_offsets_.resize(blocks_.size() + 1);
+  block_offsets_[0] = 0;
+  for (int b = 0; b < blocks_.size(); ++b) {
+    block_offsets_[b + 1] = block_offsets_[b] + blocks_[b].leaves.size();
+  }
+  const int num_leaves = block_offsets_.back();
+  leaves_.resize(num_leaves);
+  offsets_.assign(num_leaves + 1, 0);
+  for (int b = 0; b < blocks_.size(); ++b) {
+    std::copy(blocks_[b].leaves.begin(), blocks_[b].leaves.end(),
+              leaves_.begin() + block_offsets_[b]);
+    for (const auto &[index, ref] : blocks_[b].edges) {
+      ++offsets_[block_offsets_[b] + index + 1];
+      ++offsets_[block_offsets_[ref.block] + ref.index + 1];
+    }
+  }
+  for (int i = 0; i < num_leaves; ++i) {
+    offsets_[i + 1] += offsets_[i];
+  }
+  neighbors_.resize(offsets_.back());
+  std::vector<int> cursors(offsets_.begin(), offsets_.end() - 1);
+  for (int b = 0; b < blocks_.size(); ++b) {
+    for (const auto &[index, ref] : blocks_[b].edges) {
+      const int u = block_offsets_[b] + index;
+      const int v = block_offsets_[ref.block] + ref.index;
+      neighbors_[cursors[u]++] = v;
+      neighbors_[cursors[v]++] = u;
+    }
+  }
+}
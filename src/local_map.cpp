@@ -0,0 +1,321 @@
+#include "explorer/local_map.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+// Squared distance of the voxels without any occupied voxel in the box.
+constexpr float kFarSquaredDistance = 1e20;
+} // namespace
+
+void LocalMap::Update(const octomap::OcTree *ocmap,
+                      const Eigen::Vector3f &bbx_min,
+                      const Eigen::Vector3f &bbx_max,
+                      const bool compute_distance) {
+  ocmap_ = ocmap;
+  resolution_ = ocmap->getResolution();
+  resolution_factor_ = 1.0 / ocmap->getResolution();
+  const octomap::point3d oc_bbx_min(bbx_min.x(), bbx_min.y(), bbx_min.z());
+  const octomap::point3d oc_bbx_max(bbx_max.x(), bbx_max.y(), bbx_max.z());
+
+  // Shrink the box to the known leaves, a large box over a small map would
+  // mostly store unknown voxels. The leaves are kept to be rasterized once the
+  // box is known.
+  leaves_.clear();
+  Eigen::Vector3i key_min = Eigen::Vector3i::Constant(
+      std::numeric_limits<int>::max());
+  Eigen::Vector3i key_max = Eigen::Vector3i::Constant(
+      std::numeric_limits<int>::min());
+  for (octomap::OcTree::leaf_bbx_iterator
+           it = ocmap->begin_leafs_bbx(oc_bbx_min, oc_bbx_max),
+           end = ocmap->end_leafs_bbx();
+       it != end; ++it) {
+    // A leaf covers a cube of voxels, its borders are on the voxel grid.
+    Leaf leaf;
+    const octomap::point3d center = it.getCoordinate();
+    const float half_size = it.getSize() * 0.5;
+    for (int axis = 0; axis < 3; ++axis) {
+      leaf.key_begin(axis) = static_cast<int>(
+          std::lround((center(axis) - half_size) / resolution_));
+      leaf.key_end(axis) = static_cast<int>(
+          std::lround((center(axis) + half_size) / resolution_));
+    }
+    leaf.state =
+        ocmap->isNodeOccupied(*it) ? VoxelState::kOcc : VoxelState::kFree;
+    leaf.occupancy = it->getOccupancy();
+    key_min = key_min.cwiseMin(leaf.key_begin);
+    key_max = key_max.cwiseMax(leaf.key_end - Eigen::Vector3i::Ones());
+    leaves_.push_back(leaf);
+  }
+  for (int axis = 0; axis < 3; ++axis) {
+    origin_key_(axis) =
+        static_cast<int>(std::floor(bbx_min(axis) * resolution_factor_));
+    // no known leaves, the sentinel keys would overflow the size
+    if (leaves_.empty()) {
+      size_(axis) = 0;
+      continue;
+    }
+    origin_key_(axis) = std::max(origin_key_(axis), key_min(axis));
+    const int end_key = std::min(
+        static_cast<int>(std::floor(bbx_max(axis) * resolution_factor_)),
+        key_max(axis));
+    size_(axis) = std::max(end_key - origin_key_(axis) + 1, 0);
+  }
+  if ((size_.array() == 0).any()) {
+    size_.setZero();
+  }
+  bbx_min_ = origin_key_.cast<float>() * resolution_;
+  bbx_max_ = (origin_key_ + size_).cast<float>() * resolution_;
+  const int num_voxels = size_.prod();
+  states_.assign(num_voxels, VoxelState::kUnknown);
+  occupancies_.assign(num_voxels, -1.0);
+  distances_.assign(compute_distance ? num_voxels : 0, 0.0);
+  occupancy_sums_.clear();
+  if (num_voxels == 0) {
+    return;
+  }
+
+  for (const Leaf &leaf : leaves_) {
+    const Eigen::Vector3i voxel_begin =
+        (leaf.key_begin - origin_key_).cwiseMax(0);
+    const Eigen::Vector3i voxel_end =
+        (leaf.key_end - origin_key_).cwiseMin(size_);
+    if (voxel_begin.x() >= voxel_end.x()) {
+      continue;
+    }
+    for (int k = voxel_begin.z(); k < voxel_end.z(); ++k) {
+      for (int j = voxel_begin.y(); j < voxel_end.y(); ++j) {
+        const int row = size_.x() * (j + size_.y() * k);
+        std::fill(states_.begin() + row + voxel_begin.x(),
+                  states_.begin() + row + voxel_end.x(), leaf.state);
+        std::fill(occupancies_.begin() + row + voxel_begin.x(),
+                  occupancies_.begin() + row + voxel_end.x(), leaf.occupancy);
+      }
+    }
+  }
+
+  if (!compute_distance) {
+    return;
+  }
+
+  // Exact squared distance transform, one pass along each axis.
+  for (int i = 0; i < num_voxels; ++i) {
+    distances_[i] = states_[i] == VoxelState::kOcc ? 0.0 : kFarSquaredDistance;
+  }
+  const int stride_y = size_.x();
+  const int stride_z = size_.x() * size_.y();
+  for (int k = 0; k < size_.z(); ++k) {
+    for (int j = 0; j < size_.y(); ++j) {
+      DistanceTransform1D(&distances_[j * stride_y + k * stride_z], size_.x(),
+                          1);
+    }
+  }
+  for (int k = 0; k < size_.z(); ++k) {
+    for (int i = 0; i < size_.x(); ++i) {
+      DistanceTransform1D(&distances_[i + k * stride_z], size_.y(), stride_y);
+    }
+  }
+  for (int j = 0; j < size_.y(); ++j) {
+    for (int i = 0; i < size_.x(); ++i) {
+      DistanceTransform1D(&distances_[i + j * stride_y], size_.z(), stride_z);
+    }
+  }
+  for (float &distance : distances_) {
+    distance = std::sqrt(distance) * resolution_;
+  }
+}
+
+bool LocalMap::IsInside(const Eigen::Vector3f &p, const float margin) const {
+  return (p.array() - margin >= bbx_min_.array()).all() &&
+         (p.array() + margin < bbx_max_.array()).all();
+}
+
+LocalMap::VoxelState LocalMap::GetState(const Eigen::Vector3f &p) const {
+  const int index = GetIndex(p);
+  if (index >= 0) {
+    return states_[index];
+  }
+  if (fallback_ != nullptr) {
+    return fallback_->GetState(p);
+  }
+  const octomap::OcTreeNode *node =
+      ocmap_ == nullptr ? nullptr : ocmap_->search(p.x(), p.y(), p.z());
+  if (node == nullptr) {
+    return VoxelState::kUnknown;
+  }
+  return ocmap_->isNodeOccupied(node) ? VoxelState::kOcc : VoxelState::kFree;
+}
+
+float LocalMap::GetOccupancy(const Eigen::Vector3f &p) const {
+  const int index = GetIndex(p);
+  if (index >= 0) {
+    return occupancies_[index];
+  }
+  if (fallback_ != nullptr) {
+    return fallback_->GetOccupancy(p);
+  }
+  const octomap::OcTreeNode *node =
+      ocmap_ == nullptr ? nullptr : ocmap_->search(p.x(), p.y(), p.z());
+  return node == nullptr ? -1.0 : node->getOccupancy();
+}
+
+float LocalMap::GetDistance(const Eigen::Vector3f &p) const {
+  const int index = GetIndex(p);
+  return index < 0 || distances_.empty() ? 0.0 : distances_[index];
+}
+
+void LocalMap::ComputeOccupancySums(const double occ_trs) {
+  occupancy_sums_.push_back({occ_trs, {}});
+  std::vector<uint16_t> &sums = occupancy_sums_.back().sums;
+  const int stride_y = size_.x() + 1;
+  const int stride_z = stride_y * (size_.y() + 1);
+  sums.assign(stride_z * size_.z(), 0);
+#pragma omp parallel for
+  for (int k = 0; k < size_.z(); ++k) {
+    for (int j = 0; j < size_.y(); ++j) {
+      const int row = size_.x() * (j + size_.y() * k);
+      uint16_t row_sum = 0;
+      for (int i = 0; i < size_.x(); ++i) {
+        row_sum += occupancies_[row + i] > occ_trs;
+        const int index = (i + 1) + stride_y * (j + 1) + stride_z * k;
+        sums[index] = sums[index - stride_y] + row_sum;
+      }
+    }
+  }
+}
+
+int LocalMap::CountOccupancyAbove(const Eigen::Vector3f &p_min,
+                                  const Eigen::Vector3f &p_max,
+                                  const double occ_trs) const {
+  const auto sums_it =
+      std::find_if(occupancy_sums_.begin(), occupancy_sums_.end(),
+                   [occ_trs](const OccupancySums &occupancy_sums) {
+                     return occupancy_sums.occ_trs == occ_trs;
+                   });
+  if (sums_it == occupancy_sums_.end()) {
+    return -1;
+  }
+  Eigen::Vector3i voxel_min;
+  Eigen::Vector3i voxel_max;
+  for (int axis = 0; axis < 3; ++axis) {
+    voxel_min(axis) =
+        static_cast<int>(std::floor(p_min(axis) * resolution_factor_)) -
+        origin_key_(axis);
+    voxel_max(axis) =
+        static_cast<int>(std::floor(p_max(axis) * resolution_factor_)) -
+        origin_key_(axis);
+  }
+  voxel_max.z() = voxel_min.z();
+  const Eigen::Vector3i extent =
+      voxel_max - voxel_min + Eigen::Vector3i::Ones();
+  if ((voxel_min.array() < 0).any() ||
+      (voxel_max.array() >= size_.array()).any() ||
+      extent.x() * extent.y() >= 1 << 16) {
+    return -1;
+  }
+  const std::vector<uint16_t> &sums = sums_it->sums;
+  const int stride_y = size_.x() + 1;
+  const int slice = stride_y * (size_.y() + 1) * voxel_min.z();
+  const int i0 = voxel_min.x();
+  const int i1 = voxel_max.x() + 1;
+  const int j0 = stride_y * voxel_min.y();
+  const int j1 = stride_y * (voxel_max.y() + 1);
+  const uint16_t count = sums[slice + j1 + i1] - sums[slice + j0 + i1] -
+                         sums[slice + j1 + i0] + sums[slice + j0 + i0];
+  return count;
+}
+
+void LocalMap::GetChangedKeys(const LocalMap &last,
+                              std::vector<octomap::OcTreeKey> *keys) const {
+  keys->clear();
+  // octomap keys are offset by half the key range
+  const int key_offset = 32768;
+  // The voxels [i_begin, i_end) of a row are also in the rows of last, at
+  // i + shift_x.
+  const int shift_x = origin_key_.x() - last.origin_key_.x();
+  const int i_begin = std::clamp(-shift_x, 0, size_.x());
+  const int i_end = std::clamp(last.size_.x() - shift_x, i_begin, size_.x());
+  for (int k = 0; k < size_.z(); ++k) {
+    for (int j = 0; j < size_.y(); ++j) {
+      const int last_j = origin_key_.y() + j - last.origin_key_.y();
+      const int last_k = origin_key_.z() + k - last.origin_key_.z();
+      const bool has_last_row = last_j >= 0 && last_j < last.size_.y() &&
+                                last_k >= 0 && last_k < last.size_.z();
+      const int row = size_.x() * (j + size_.y() * k);
+      const int last_row =
+          last.size_.x() * (last_j + last.size_.y() * last_k) + shift_x;
+      // Most rows do not change, compared at once.
+      const bool is_same_row =
+          has_last_row &&
+          std::equal(states_.begin() + row + i_begin,
+                     states_.begin() + row + i_end,
+                     last.states_.begin() + last_row + i_begin) &&
+          std::equal(occupancies_.begin() + row + i_begin,
+                     occupancies_.begin() + row + i_end,
+                     last.occupancies_.begin() + last_row + i_begin);
+      for (int i = 0; i < size_.x(); ++i) {
+        if (has_last_row && i >= i_begin && i < i_end &&
+            (is_same_row ||
+             (states_[row + i] == last.states_[last_row + i] &&
+              occupancies_[row + i] == last.occupancies_[last_row + i]))) {
+          continue;
+        }
+        const Eigen::Vector3i key = origin_key_ + Eigen::Vector3i(i, j, k);
+        keys->emplace_back(key.x() + key_offset, key.y() + key_offset,
+                           key.z() + key_offset);
+      }
+    }
+  }
+}
+
+int LocalMap::GetIndex(const Eigen::Vector3f &p) const {
+  int index = 0;
+  int stride = 1;
+  for (int axis = 0; axis < 3; ++axis) {
+    const int key =
+        static_cast<int>(std::floor(p(axis) * resolution_factor_)) -
+        origin_key_(axis);
+    if (key < 0 || key >= size_(axis)) {
+      return -1;
+    }
+    index += key * stride;
+    stride *= size_(axis);
+  }
+  return index;
+}
+
+void LocalMap::DistanceTransform1D(float *f, const int n, const int stride) {
+  line_f_.resize(n);
+  line_v_.resize(n);
+  line_z_.resize(n + 1);
+  for (int q = 0; q < n; ++q) {
+    line_f_[q] = f[q * stride];
+  }
+  // Intersection of the parabolas rooted at q and p.
+  auto intersect = [&](const int q, const int p) {
+    return ((line_f_[q] + q * q) - (line_f_[p] + p * p)) / (2 * q - 2 * p);
+  };
+  int k = 0;
+  line_v_[0] = 0;
+  line_z_[0] = -std::numeric_limits<float>::infinity();
+  line_z_[1] = std::numeric_limits<float>::infinity();
+  for (int q = 1; q < n; ++q) {
+    float s = intersect(q, line_v_[k]);
+    while (s <= line_z_[k]) {
+      --k;
+      s = intersect(q, line_v_[k]);
+    }
+    ++k;
+    line_v_[k] = q;
+    line_z_[k] = s;
+    line_z_[k + 1] = std::numeric_limits<float>::infinity();
+  }
+  k = 0;
+  for (int q = 0; q < n; ++q) {
+    while (line_z_[k + 1] < q) {
+      ++k;
+    }
+    const int d = q - line_v_[k];
+    f[q * stride] = d * d + line_f_[line_v_[k]];
+  }
+}
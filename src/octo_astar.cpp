@@ -5,11 +5,8 @@
 #include <functional>
 #include <geometry_msgs/PoseStamped.h>
 #include <map>
-#include <memory>
-#include <queue>
 #include <stack>
 #include <string>
-#include <unordered_map>
 
 const std::vector<Eigen::Vector3f> center_offset = {
     {-1.0, -1.0, -1.0}, {1.0, -1.0, -1.0}, {-1.0, 1.0, -1.0}, {1.0, 1.0, -1.0},
@@ -24,111 +21,120 @@ const std::vector<std::vector<int>> adj_child = {{1, 3, 5, 7}, {0, 2, 4, 6},
                                                  {4, 5, 6, 7}, {0, 1, 2, 3}};
 
 OctoAstar::OctoAstar(const octomap::OcTree *ocmap) : ocmap_(ocmap) {
-  root_node_ = std::make_shared<OctoNode>(
-      ocmap_->getRoot(), Eigen::Vector3f(0.0, 0.0, 0.0), 0.1 * 65536, nullptr);
+  octo_nodes_.emplace_back(ocmap_->getRoot(), Eigen::Vector3f(0.0, 0.0, 0.0),
+                           0.1 * 65536, -1);
 }
 
-std::shared_ptr<OctoNode> OctoAstar::search_octonode(const Eigen::Vector3f &p) {
-  std::shared_ptr<OctoNode> octo_node = root_node_;
-  while (ocmap_->nodeHasChildren(octo_node->node_)) {
-    Eigen::Vector3f node_center = octo_node->center_;
+int OctoAstar::child_get(const int octo_id, const int child_id) {
+  const int id = octo_nodes_[octo_id].child_id_[child_id];
+  if (id >= 0) {
+    return id;
+  }
+  octomap::OcTreeNode *node = octo_nodes_[octo_id].node_;
+  if (!ocmap_->nodeChildExists(node, child_id)) {
+    return -1;
+  }
+  // the father is copied, emplace_back may move the arena
+  const Eigen::Vector3f center = octo_nodes_[octo_id].center_;
+  const float half_size = octo_nodes_[octo_id].half_size_;
+  octo_nodes_[octo_id].child_id_[child_id] = octo_nodes_.size();
+  octo_nodes_.emplace_back(ocmap_->getNodeChild(node, child_id),
+                           center + 0.5 * half_size * center_offset[child_id],
+                           half_size, octo_id);
+  return octo_nodes_.size() - 1;
+}
+
+int OctoAstar::search_octonode(const Eigen::Vector3f &p) {
+  int octo_id = 0;
+  while (ocmap_->nodeHasChildren(octo_nodes_[octo_id].node_)) {
+    const Eigen::Vector3f &node_center = octo_nodes_[octo_id].center_;
     int child_id = 1 * (p.x() > node_center.x()) +
                    2 * (p.y() > node_center.y()) +
                    4 * (p.z() > node_center.z());
-    if (ocmap_->nodeChildExists(octo_node->node_, child_id)) {
-      if (octo_node->child_node_[child_id] == nullptr) {
-        octo_node->child_node_[child_id] = std::make_shared<OctoNode>(
-            ocmap_->getNodeChild(octo_node->node_, child_id),
-            node_center + 0.5 * octo_node->half_size_ * center_offset[child_id],
-            octo_node->half_size_, octo_node);
-      }
-      octo_node = octo_node->child_node_[child_id];
-    } else {
-      return nullptr;
+    octo_id = child_get(octo_id, child_id);
+    if (octo_id < 0) {
+      return -1;
     }
   }
-  return octo_node;
+  return octo_id;
 }
 
 float OctoAstar::astar_path_distance(const Eigen::Vector3f &start_p,
                                      const Eigen::Vector3f &end_p) {
 
   const int expand_size = expand_offset.size();
+  // the A* nodes of the last search are dropped at once, a new search id
+  // unlinks them from the wrappers
+  astar_nodes_.clear();
+  astar_q_.clear();
+  ++search_id_;
 
   // search the node at start_p from top to bottom
-  std::shared_ptr<OctoNode> octo_node = search_octonode(start_p);
-  if (octo_node == nullptr) {
+  const int start_id = search_octonode(start_p);
+  if (start_id < 0) {
     return 999.0;
   }
 
-  std::priority_queue<std::shared_ptr<OctoAstarNode>,
-                      std::vector<std::shared_ptr<OctoAstarNode>>,
-                      OctoAstarNodeCmp>
-      astar_q;
-
   bool is_path_found = false;
   int count = 0;
 
-  OctoAstarNodeKey astar_root_key(octo_node->center_);
-  std::shared_ptr<OctoAstarNode> astar_root =
-      std::make_shared<OctoAstarNode>(octo_node->center_);
-  astar_root->octo_node_ = octo_node;
-  astar_root->father_node_ = nullptr;
-  astar_root->g_score_ = 0.0;
-  astar_root->h_score_ = calc_h_score(astar_root->position_, end_p);
-  astar_root->f_score_ = astar_root->g_score_ + astar_root->h_score_;
-  astar_root->state = 0;
-  node_at_key.emplace(astar_root_key, astar_root);
-  astar_q.push(astar_root);
-  std::shared_ptr<OctoAstarNode> end_astar_node = nullptr;
-
-  while (!astar_q.empty()) {
+  OctoAstarNode astar_root(octo_nodes_[start_id].center_);
+  astar_root.octo_id_ = start_id;
+  astar_root.father_id_ = -1;
+  astar_root.g_score_ = 0.0;
+  astar_root.h_score_ = calc_h_score(astar_root.position_, end_p);
+  astar_root.f_score_ = astar_root.g_score_ + astar_root.h_score_;
+  astar_root.state = 0;
+  octo_nodes_[start_id].search_id_ = search_id_;
+  octo_nodes_[start_id].astar_id_ = 0;
+  astar_nodes_.push_back(astar_root);
+  astar_q_.emplace_back(astar_root.f_score_, 0);
+  int end_astar_id = -1;
+
+  while (!astar_q_.empty()) {
     ++count;
-    std::shared_ptr<OctoAstarNode> astar_node = astar_q.top();
-    std::shared_ptr<OctoNode> cur_octo_node = astar_node->octo_node_;
-    astar_q.pop();
+    std::pop_heap(astar_q_.begin(), astar_q_.end(), OctoAstarNodeCmp());
+    const int astar_id = astar_q_.back().second;
+    astar_q_.pop_back();
 
     // skip the same node due to the update of g_score
-    if (astar_node->state == 1) {
+    if (astar_nodes_[astar_id].state == 1) {
       continue;
     }
     // set node to closed
-    astar_node->state = 1;
-    if (cur_octo_node->is_in_bbx(end_p)) {
+    astar_nodes_[astar_id].state = 1;
+    const int cur_id = astar_nodes_[astar_id].octo_id_;
+    if (octo_nodes_[cur_id].is_in_bbx(end_p)) {
       is_path_found = true;
-      end_astar_node = astar_node;
+      end_astar_id = astar_id;
       break;
     }
+    const Eigen::Vector3f cur_pos = astar_nodes_[astar_id].position_;
+    const float cur_size = octo_nodes_[cur_id].size_;
 
     // expand in six directions
     for (int i = 0; i < expand_size; ++i) {
-      Eigen::Vector3f next_pos =
-          astar_node->position_ + cur_octo_node->size_ * expand_offset[i];
+      Eigen::Vector3f next_pos = cur_pos + cur_size * expand_offset[i];
 
       // search for free adjacent leaf octo node
       // go from bottom to top until bbx contains next_pos
-      std::shared_ptr<OctoNode> next_node = cur_octo_node->father_node_;
-      while (!next_node->is_in_bbx(next_pos)) {
-        next_node = next_node->father_node_;
+      int next_id = octo_nodes_[cur_id].father_id_;
+      while (next_id >= 0 && !octo_nodes_[next_id].is_in_bbx(next_pos)) {
+        next_id = octo_nodes_[next_id].father_id_;
+      }
+      if (next_id < 0) {
+        continue;
       }
       bool is_adj_node_null = false;
       // go from top to bottom until reaching specified depth
-      while (ocmap_->nodeHasChildren(next_node->node_) &&
-             next_node->size_ > cur_octo_node->size_) {
-        Eigen::Vector3f node_center = next_node->center_;
+      while (ocmap_->nodeHasChildren(octo_nodes_[next_id].node_) &&
+             octo_nodes_[next_id].size_ > cur_size) {
+        const Eigen::Vector3f &node_center = octo_nodes_[next_id].center_;
         int child_id = 1 * (next_pos.x() > node_center.x()) +
                        2 * (next_pos.y() > node_center.y()) +
                        4 * (next_pos.z() > node_center.z());
-        if (ocmap_->nodeChildExists(next_node->node_, child_id)) {
-          if (next_node->child_node_[child_id] == nullptr) {
-            next_node->child_node_[child_id] = std::make_shared<OctoNode>(
-                ocmap_->getNodeChild(next_node->node_, child_id),
-                node_center +
-                    0.5 * next_node->half_size_ * center_offset[child_id],
-                next_node->half_size_, next_node);
-          }
-          next_node = next_node->child_node_[child_id];
-        } else {
+        next_id = child_get(next_id, child_id);
+        if (next_id < 0) {
           is_adj_node_null = true;
           break;
         }
@@ -139,47 +145,40 @@ float OctoAstar::astar_path_distance(const Eigen::Vector3f &start_p,
       }
 
       // big node to small node, may add multi nodes
-      if (ocmap_->nodeHasChildren(next_node->node_)) {
+      if (ocmap_->nodeHasChildren(octo_nodes_[next_id].node_)) {
         // bfs
-        std::queue<std::shared_ptr<OctoNode>> bfs_q;
-        bfs_q.push(next_node);
-        while (!bfs_q.empty()) {
-          std::shared_ptr<OctoNode> bfs_node = bfs_q.front();
-          bfs_q.pop();
-
-          if (!ocmap_->nodeHasChildren(bfs_node->node_)) {
-            if (!ocmap_->isNodeOccupied(bfs_node->node_)) {
-              add_node_to_q(bfs_node, astar_node, end_p, astar_q);
+        bfs_q_.clear();
+        bfs_q_.push_back(next_id);
+        for (int head = 0; head < bfs_q_.size(); ++head) {
+          const int bfs_id = bfs_q_[head];
+          octomap::OcTreeNode *bfs_node = octo_nodes_[bfs_id].node_;
+
+          if (!ocmap_->nodeHasChildren(bfs_node)) {
+            if (!ocmap_->isNodeOccupied(bfs_node)) {
+              add_node_to_q(bfs_id, astar_id, end_p);
             }
             continue;
           }
 
-          if (bfs_node->size_ < 0.2)
+          if (octo_nodes_[bfs_id].size_ < 0.2)
             continue;
 
           for (int index = 0; index < 4; ++index) {
-            if (ocmap_->nodeChildExists(bfs_node->node_, adj_child[i][index])) {
+            if (ocmap_->nodeChildExists(bfs_node, adj_child[i][index])) {
               octomap::OcTreeNode *childe_node =
-                  ocmap_->getNodeChild(bfs_node->node_, adj_child[i][index]);
+                  ocmap_->getNodeChild(bfs_node, adj_child[i][index]);
               if (ocmap_->isNodeOccupied(childe_node)) {
                 continue;
               }
-              std::shared_ptr<OctoNode> bfs_nbr_node =
-                  std::make_shared<OctoNode>(
-                      childe_node,
-                      bfs_node->center_ +
-                          0.5 * bfs_node->half_size_ *
-                              center_offset[adj_child[i][index]],
-                      bfs_node->half_size_, bfs_node);
-              bfs_q.push(bfs_nbr_node);
+              bfs_q_.push_back(child_get(bfs_id, adj_child[i][index]));
             }
           }
         }
       } else {
         // small node to big node, only add one node, shift to the center of
         // free leaf node
-        if (!ocmap_->isNodeOccupied(next_node->node_)) {
-          add_node_to_q(next_node, astar_node, end_p, astar_q);
+        if (!ocmap_->isNodeOccupied(octo_nodes_[next_id].node_)) {
+          add_node_to_q(next_id, astar_id, end_p);
         }
       }
     }
@@ -189,19 +188,114 @@ float OctoAstar::astar_path_distance(const Eigen::Vector3f &start_p,
     float distance = 0.0;
     path_.clear();
     // add accurate end point
-    path_.emplace_back(std::make_shared<OctoAstarNode>(end_p));
-    std::shared_ptr<OctoAstarNode> last_path_node = end_astar_node;
-    distance += (end_astar_node->position_ - end_p).norm();
-    path_.emplace_back(end_astar_node);
-    std::shared_ptr<OctoAstarNode> path_node = end_astar_node->father_node_;
-    while (path_node != nullptr) {
-      distance += (path_node->position_ - last_path_node->position_).norm();
-      path_.emplace_back(path_node);
-      last_path_node = path_node;
-      path_node = path_node->father_node_;
+    path_.push_back(end_p);
+    Eigen::Vector3f last_position = astar_nodes_[end_astar_id].position_;
+    distance += (last_position - end_p).norm();
+    path_.push_back(last_position);
+    for (int id = astar_nodes_[end_astar_id].father_id_; id != -1;
+         id = astar_nodes_[id].father_id_) {
+      const Eigen::Vector3f &position = astar_nodes_[id].position_;
+      distance += (position - last_position).norm();
+      path_.push_back(position);
+      last_position = position;
+    }
+    distance += (last_position - start_p).norm();
+    path_.push_back(start_p);
+    reverse(path_.begin(), path_.end());
+    std::cout << "[Astar] waypoint generated!! waypoint num: " << path_.size()
+              << ", select node num: " << count << std::endl;
+    return distance;
+  } else {
+    std::cout << "[WARNING] no path !! from " << std::endl
+              << start_p << std::endl
+              << "to " << std::endl
+              << end_p << std::endl;
+    return (end_p - start_p).norm();
+  }
+}
+
+float OctoAstar::graph_path_distance(const LeafGraph &graph,
+                                     const Eigen::Vector3f &start_p,
+                                     const Eigen::Vector3f &end_p) {
+  const int start_id = graph.Find(start_p);
+  if (start_id < 0) {
+    return 999.0;
+  }
+  // the goal leaf, -1 searches until the open list is empty like the tree
+  // search with an end point outside the free leaves
+  const int end_id = graph.Find(end_p);
+  leaf_states_.resize(graph.size());
+  astar_q_.clear();
+  ++search_id_;
+
+  int count = 0;
+  leaf_states_[start_id].search_id = search_id_;
+  leaf_states_[start_id].is_closed = false;
+  leaf_states_[start_id].father_id = -1;
+  leaf_states_[start_id].g_score = 0.0;
+  astar_q_.emplace_back(calc_h_score(graph.leaf(start_id).center, end_p),
+                        start_id);
+
+  while (!astar_q_.empty()) {
+    ++count;
+    std::pop_heap(astar_q_.begin(), astar_q_.end(), OctoAstarNodeCmp());
+    const int cur_id = astar_q_.back().second;
+    astar_q_.pop_back();
+
+    LeafState &cur_state = leaf_states_[cur_id];
+    // skip the same leaf due to the update of g_score
+    if (cur_state.is_closed) {
+      continue;
+    }
+    cur_state.is_closed = true;
+    if (cur_id == end_id) {
+      break;
+    }
+    const Eigen::Vector3f &cur_pos = graph.leaf(cur_id).center;
+    const float cur_g_score = cur_state.g_score;
+
+    // the neighbors are a scan of the adjacency of the leaf
+    graph.ForEachNeighbor(cur_id, [&](const int next_id) {
+      const Eigen::Vector3f &next_pos = graph.leaf(next_id).center;
+      if (next_pos.z() > max_z_ || next_pos.z() < min_z_) {
+        return;
+      }
+      const float next_g_score = cur_g_score + (next_pos - cur_pos).norm();
+      LeafState &next_state = leaf_states_[next_id];
+      if (next_state.search_id == search_id_) {
+        if (next_state.is_closed || next_g_score > next_state.g_score) {
+          return;
+        }
+      } else {
+        next_state.search_id = search_id_;
+        next_state.is_closed = false;
+      }
+      next_state.father_id = cur_id;
+      next_state.g_score = next_g_score;
+      astar_q_.emplace_back(next_g_score + calc_h_score(next_pos, end_p),
+                            next_id);
+      std::push_heap(astar_q_.begin(), astar_q_.end(), OctoAstarNodeCmp());
+    });
+  }
+
+  if (end_id >= 0 && leaf_states_[end_id].search_id == search_id_ &&
+      leaf_states_[end_id].is_closed) {
+    float distance = 0.0;
+    path_.clear();
+    // add accurate end point
+    path_.push_back(end_p);
+    Eigen::Vector3f last_position = graph.leaf(end_id).center;
+    distance += (last_position - end_p).norm();
+    path_.push_back(last_position);
+    for (int id = leaf_states_[end_id].father_id; id != -1;
+         id = leaf_states_[id].father_id) {
+      const Eigen::Vector3f &position = graph.leaf(id).center;
+      distance += (position - last_position).norm();
+      path_.push_back(position);
+      last_position = position;
     }
-    distance += (last_path_node->position_ - start_p).norm();
-    path_.emplace_back(std::make_shared<OctoAstarNode>(start_p));
+    distance += (last_position - start_p).norm();
+    path_.push_back(start_p);
     reverse(path_.begin(), path_.end());
     std::cout << "[Astar] waypoint generated!! waypoint num: " << path_.size()
               << ", select node num: " << count << std::endl;
@@ -254,52 +348,52 @@ bool OctoAstar::is_path_valid(const Eigen::Vector3f &cur_pos,
   return true;
 }
 
-inline bool OctoAstar::add_node_to_q(
-    const std::shared_ptr<OctoNode> &next_node,
-    const std::shared_ptr<OctoAstarNode> &cur_node,
-    const Eigen::Vector3f &end_p,
-    std::priority_queue<std::shared_ptr<OctoAstarNode>,
-                        std::vector<std::shared_ptr<OctoAstarNode>>,
-                        OctoAstarNodeCmp> &astar_q) {
+inline bool OctoAstar::add_node_to_q(const int next_octo_id,
+                                     const int cur_astar_id,
+                                     const Eigen::Vector3f &end_p) {
   // check next node is valid
-  Eigen::Vector3f next_pos = next_node->center_;
+  OctoNode &next_node = octo_nodes_[next_octo_id];
+  Eigen::Vector3f next_pos = next_node.center_;
   if (next_pos.z() > max_z_ || next_pos.z() < min_z_) {
     return false;
   }
 
-  OctoAstarNodeKey astar_key(next_pos);
-  const float delta_g = (next_pos - cur_node->position_).norm();
+  const OctoAstarNode &cur_node = astar_nodes_[cur_astar_id];
+  const float next_g_score =
+      cur_node.g_score_ + (next_pos - cur_node.position_).norm();
 
   // check if node is in open/closed list
-  if (node_at_key.find(astar_key) != node_at_key.end()) {
-    std::shared_ptr<OctoAstarNode> next_astar_node = node_at_key[astar_key];
-    if (next_astar_node->state == 1) {
+  if (next_node.search_id_ == search_id_) {
+    OctoAstarNode &next_astar_node = astar_nodes_[next_node.astar_id_];
+    if (next_astar_node.state == 1) {
       return false;
     }
     // next node is in open list, and the distance through the current node to
     // next node is farther.
-    if (next_astar_node->state == 0 &&
-        cur_node->g_score_ + delta_g > next_astar_node->g_score_) {
+    if (next_astar_node.state == 0 &&
+        next_g_score > next_astar_node.g_score_) {
       return false;
     }
     // update father node and g/f_score
-    next_astar_node->father_node_ = cur_node;
-    next_astar_node->g_score_ = cur_node->g_score_ + delta_g;
-    next_astar_node->f_score_ =
-        next_astar_node->g_score_ + next_astar_node->h_score_;
-    astar_q.push(next_astar_node);
+    next_astar_node.father_id_ = cur_astar_id;
+    next_astar_node.g_score_ = next_g_score;
+    next_astar_node.f_score_ =
+        next_astar_node.g_score_ + next_astar_node.h_score_;
+    astar_q_.emplace_back(next_astar_node.f_score_, next_node.astar_id_);
   } else {
-    std::shared_ptr<OctoAstarNode> next_astar_node =
-        std::make_shared<OctoAstarNode>(next_pos);
-    next_astar_node->octo_node_ = next_node;
-    next_astar_node->father_node_ = cur_node;
-    next_astar_node->state = 0;
-    next_astar_node->g_score_ = cur_node->g_score_ + delta_g;
-    next_astar_node->h_score_ = calc_h_score(next_pos, end_p);
-    next_astar_node->f_score_ =
-        next_astar_node->g_score_ + next_astar_node->h_score_;
-    node_at_key[astar_key] = next_astar_node;
-    astar_q.push(next_astar_node);
+    OctoAstarNode next_astar_node(next_pos);
+    next_astar_node.octo_id_ = next_octo_id;
+    next_astar_node.father_id_ = cur_astar_id;
+    next_astar_node.state = 0;
+    next_astar_node.g_score_ = next_g_score;
+    next_astar_node.h_score_ = calc_h_score(next_pos, end_p);
+    next_astar_node.f_score_ =
+        next_astar_node.g_score_ + next_astar_node.h_score_;
+    next_node.search_id_ = search_id_;
+    next_node.astar_id_ = astar_nodes_.size();
+    astar_q_.emplace_back(next_astar_node.f_score_, next_node.astar_id_);
+    astar_nodes_.push_back(next_astar_node);
   }
+  std::push_heap(astar_q_.begin(), astar_q_.end(), OctoAstarNodeCmp());
   return true;
 }
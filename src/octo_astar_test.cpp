@@ -1,7 +1,15 @@
+#include "explorer/astar.h"
+#include "explorer/grid_astar.h"
+#include "explorer/leaf_graph.h"
+#include "explorer/local_map.h"
 #include "explorer/octo_astar.h"
 #include <Eigen/Dense>
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cstdlib>
 #include <geometry_msgs/Point.h>
+#include <new>
 #include <octomap/octomap.h>
 #include <octomap_msgs/Octomap.h>
 #include <octomap_msgs/conversions.h>
@@ -10,10 +18,54 @@
 #include <visualization_msgs/Marker.h>
 #include <visualization_msgs/MarkerArray.h>
 
+// heap allocations and frees, counted to report the ones of a search
+long num_allocations = 0;
+long num_frees = 0;
+void *operator new(std::size_t size) {
+  ++num_allocations;
+  if (void *p = std::malloc(size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept {
+  if (p != nullptr) {
+    ++num_frees;
+  }
+  std::free(p);
+}
+void operator delete(void *p, std::size_t) noexcept { operator delete(p); }
+
 octomap::OcTree *ocmap = nullptr;
+// the leaf graph and the grid are rebuilt for each new map
+bool is_map_new = false;
 void octomap_cb(const octomap_msgs::Octomap::ConstPtr &msg) {
   delete ocmap;
   ocmap = dynamic_cast<octomap::OcTree *>(msgToMap(*msg));
+  is_map_new = true;
+}
+
+// Leaves as (key, size) and edges as the keys of their two leaves, sorted, as
+// the leaf ids differ between Build and Update.
+bool is_same_graph(const LeafGraph &a, const LeafGraph &b) {
+  std::vector<std::array<int, 4>> leaves[2];
+  std::vector<std::array<int, 6>> edges[2];
+  const LeafGraph *graphs[2] = {&a, &b};
+  for (int g = 0; g < 2; ++g) {
+    const LeafGraph &graph = *graphs[g];
+    for (int i = 0; i < graph.size(); ++i) {
+      const Eigen::Vector3i &key = graph.leaf(i).key;
+      leaves[g].push_back({key.x(), key.y(), key.z(), graph.leaf(i).size});
+      graph.ForEachNeighbor(i, [&](const int j) {
+        const Eigen::Vector3i &next_key = graph.leaf(j).key;
+        edges[g].push_back({key.x(), key.y(), key.z(), next_key.x(),
+                            next_key.y(), next_key.z()});
+      });
+    }
+    std::sort(leaves[g].begin(), leaves[g].end());
+    std::sort(edges[g].begin(), edges[g].end());
+  }
+  return leaves[0] == leaves[1] && edges[0] == edges[1];
 }
 
 int main(int argc, char **argv) {
@@ -56,11 +108,57 @@ int main(int argc, char **argv) {
 
   visualization_msgs::MarkerArray marker_array;
 
+  // the other planners on the same map, for comparison
+  LeafGraph leaf_graph;
+  // same graph built from scratch, to compare
+  LeafGraph built_graph;
+  // occupancy cache of the whole map, to update the leaf graph from the
+  // changed voxels
+  LocalMap graph_map;
+  LocalMap last_graph_map;
+  LocalMap local_map;
+  Astar astar;
+  GridAstar grid_astar(-10.5, 10.5, -10.5, 10.5, 0.0, 2.5);
+
   while (ros::ok()) {
     rate.sleep();
     ros::spinOnce();
     if (ocmap == nullptr)
       continue;
+    if (is_map_new) {
+      double min_x, min_y, min_z, max_x, max_y, max_z;
+      ocmap->getMetricMin(min_x, min_y, min_z);
+      ocmap->getMetricMax(max_x, max_y, max_z);
+      std::swap(last_graph_map, graph_map);
+      graph_map.Update(ocmap, Eigen::Vector3f(min_x, min_y, min_z),
+                       Eigen::Vector3f(max_x, max_y, max_z), false);
+      std::vector<octomap::OcTreeKey> changed_keys;
+      graph_map.GetChangedKeys(last_graph_map, &changed_keys);
+      auto build_start = std::chrono::system_clock::now();
+      leaf_graph.Update(ocmap, changed_keys);
+      std::chrono::duration<float, std::milli> graph_update =
+          std::chrono::system_clock::now() - build_start;
+      build_start = std::chrono::system_clock::now();
+      built_graph.Build(ocmap);
+      std::chrono::duration<float, std::milli> graph_build =
+          std::chrono::system_clock::now() - build_start;
+      std::cout << "[leaf graph] update: " << graph_update.count()
+                << " ms from " << changed_keys.size()
+                << " changed voxels, build: " << graph_build.count() << " ms"
+                << (is_same_graph(leaf_graph, built_graph) ? " (same)"
+                                                           : " (differ)")
+                << std::endl;
+      build_start = std::chrono::system_clock::now();
+      grid_astar.UpdateFromMap(ocmap, octomap::point3d(-10.5, -10.5, 0.0),
+                               octomap::point3d(10.5, 10.5, 2.5));
+      std::chrono::duration<float, std::milli> grid_build =
+          std::chrono::system_clock::now() - build_start;
+      std::cout << "[leaf graph] " << leaf_graph.size() << " leaves, "
+                << leaf_graph.num_edges()
+                << " edges; [grid] update: " << grid_build.count() << " ms"
+                << std::endl;
+      is_map_new = false;
+    }
 
     // astar test
     // 设定起点终点
@@ -78,17 +176,71 @@ int main(int argc, char **argv) {
       continue;
 
     // A*寻路，并统计时间
-    OctoAstar octo_astar(ocmap);
+    const long allocations_before = num_allocations;
+    const long frees_before = num_frees;
+    std::vector<Eigen::Vector3f> path;
     auto start_time = std::chrono::system_clock::now();
-    octo_astar.astar_path_distance(start_pt, end_pt);
+    long search_allocations = 0;
+    int num_octo_nodes = 0;
+    int num_astar_nodes = 0;
+    float tree_distance = 0.0;
+    {
+      OctoAstar octo_astar(ocmap);
+      tree_distance = octo_astar.astar_path_distance(start_pt, end_pt);
+      search_allocations = num_allocations - allocations_before;
+      num_octo_nodes = octo_astar.num_octo_nodes();
+      num_astar_nodes = octo_astar.num_astar_nodes();
+      path = octo_astar.path_;
+    }
     auto end_time = std::chrono::system_clock::now();
     std::chrono::duration<float, std::milli> elapsed = end_time - start_time;
-    std::cout << "[astar search] :" << elapsed.count() << " ms" << std::endl;
+    // the blocks still alive after the planner is gone are leaked, the path
+    // copy excepted
+    const long leaked = num_allocations - allocations_before -
+                        (num_frees - frees_before) - (path.empty() ? 0 : 1);
+    std::cout << "[astar search] :" << elapsed.count() << " ms, allocations "
+              << search_allocations << ", leaked " << leaked << ", wrappers "
+              << num_octo_nodes << ", A* nodes " << num_astar_nodes
+              << std::endl;
+
+    // the same query on the leaf graph, the local map and the grid
+    start_time = std::chrono::system_clock::now();
+    float graph_distance = 0.0;
+    {
+      OctoAstar octo_astar(ocmap);
+      graph_distance =
+          octo_astar.graph_path_distance(leaf_graph, start_pt, end_pt);
+    }
+    std::chrono::duration<float, std::milli> graph_elapsed =
+        std::chrono::system_clock::now() - start_time;
+    start_time = std::chrono::system_clock::now();
+    const Eigen::Vector3f margin(1.5, 1.5, 0.0);
+    // the box of the query, over the z range of Astar
+    Eigen::Vector3f local_min = start_pt.cwiseMin(end_pt) - margin;
+    Eigen::Vector3f local_max = start_pt.cwiseMax(end_pt) + margin;
+    local_min.z() = 0.0;
+    local_max.z() = 2.5;
+    local_map.Update(ocmap, local_min, local_max, false);
+    const float local_distance =
+        astar.astar_path_distance(local_map, start_pt, end_pt);
+    std::chrono::duration<float, std::milli> local_elapsed =
+        std::chrono::system_clock::now() - start_time;
+    start_time = std::chrono::system_clock::now();
+    const GridAstarOutput grid_output =
+        grid_astar.AstarPathDistance(start_pt, end_pt);
+    std::chrono::duration<float, std::milli> grid_elapsed =
+        std::chrono::system_clock::now() - start_time;
+    std::cout << "[compare] octree: " << elapsed.count() << " ms, "
+              << tree_distance << " m; leaf graph: " << graph_elapsed.count()
+              << " ms, " << graph_distance
+              << " m; local map: " << local_elapsed.count() << " ms, "
+              << local_distance << " m; grid: " << grid_elapsed.count()
+              << " ms, " << grid_output.path_length << " m" << std::endl;
     // 可视化轨迹
     waypoint.points.clear();
-    const int wp_num = octo_astar.path_.size();
+    const int wp_num = path.size();
     for (int i = 0; i < wp_num; ++i) {
-      const Eigen::Vector3f pos = octo_astar.path_[i]->position_;
+      const Eigen::Vector3f pos = path[i];
       geometry_msgs::Point wp_pos;
       wp_pos.x = pos.x();
       wp_pos.y = pos.y();